@@ -0,0 +1,348 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "pdfgenerator.h"
+
+#include "colortransform.h"
+#include "documentloader.h"
+#include "rendercache.h"
+#include "searchengine.h"
+
+#include "config.h"
+
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QFileInfo>
+#include <QGuiApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QTimer>
+
+#include <QPdfDocument>
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef Q_OS_UNIX
+#include <sys/resource.h>
+#endif
+
+
+// nothing should take this long: give up instead of hanging
+static const int TIMEOUT_MSECS = 10 * 60 * 1000;
+
+static const qreal ZOOM_LEVELS[] = { 0.5, 1.0, 2.0, 4.0 };
+
+// pages rendered for each zoom level, and searches repeated
+static const int RENDER_SAMPLES = 20;
+static const int SEARCH_SAMPLES = 50;
+
+// passes of each color transform kernel, over an A4 page at 300 dpi
+static const int COLOR_SAMPLES = 20;
+static const QSize COLOR_IMAGE_SIZE(2481, 3508);
+
+
+static double elapsedMsecs(const QElapsedTimer &timer)
+{
+    return timer.nsecsElapsed() / 1e6;
+}
+
+
+static QJsonObject percentiles(QVector<double> samples)
+{
+    QJsonObject result;
+    if (samples.isEmpty()) {
+        return result;
+    }
+
+    std::sort(samples.begin(), samples.end());
+    auto at = [&] (double p) {
+        const int index = qBound(0, int(std::ceil(p * samples.count())) - 1, samples.count() - 1);
+        return samples.at(index);
+    };
+    result.insert( QStringLiteral("p50"), at(0.50) );
+    result.insert( QStringLiteral("p90"), at(0.90) );
+    result.insert( QStringLiteral("p99"), at(0.99) );
+    result.insert( QStringLiteral("max"), samples.last() );
+    result.insert( QStringLiteral("samples"), samples.count() );
+    return result;
+}
+
+
+static qint64 peakRssKiB()
+{
+#ifdef Q_OS_UNIX
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef Q_OS_MACOS
+        return usage.ru_maxrss / 1024;
+#else
+        return usage.ru_maxrss;
+#endif
+    }
+#endif
+    return -1;
+}
+
+
+// runs an event loop until signal is emitted, or the time is out
+template <typename Sender, typename Signal>
+static bool waitFor(Sender *sender, Signal signal)
+{
+    QEventLoop loop;
+    QTimer timer;
+    timer.setSingleShot(true);
+    QObject::connect(&timer, &QTimer::timeout, &loop, [&] () { loop.exit(1); });
+    QObject::connect(sender, signal, &loop, [&] () { loop.exit(0); });
+    timer.start(TIMEOUT_MSECS);
+    return loop.exec() == 0;
+}
+
+
+static QJsonObject benchDocument(const QString &name, const QString &path)
+{
+    QJsonObject result;
+    result.insert( QStringLiteral("name"), name );
+    result.insert( QStringLiteral("bytes"), QFileInfo(path).size() );
+
+    // open && first page: the same path a window goes through
+    RenderCache cache;
+    DocumentLoader loader;
+    QPdfDocument* document = nullptr;
+
+    QEventLoop loop;
+    QObject::connect(&loader, &DocumentLoader::loaded, &loop, [&] (QPdfDocument *doc) {
+            document = doc;
+            loop.quit();
+        }
+    );
+    QObject::connect(&loader, &DocumentLoader::failed, &loop, &QEventLoop::quit);
+
+    QElapsedTimer timer;
+    timer.start();
+    loader.load(path);
+    loop.exec();
+    if (!document) {
+        result.insert( QStringLiteral("error"), QStringLiteral("cannot open") );
+        return result;
+    }
+    result.insert( QStringLiteral("open_ms"), elapsedMsecs(timer) );
+    result.insert( QStringLiteral("pages"), document->pageCount() );
+
+    const QSize firstPageSize = (document->pageSize(0) * 96 / 72.0).toSize();
+    cache.request(RenderKey(document, 0, 1.0, 1.0), firstPageSize);
+    waitFor(&cache, &RenderCache::pageRendered);
+    result.insert( QStringLiteral("first_page_ms"), elapsedMsecs(timer) );
+
+    // render latency, one page at a time
+    QJsonObject render;
+    const int pageCount = document->pageCount();
+    const int step = qMax(1, pageCount / RENDER_SAMPLES);
+    for (const qreal zoom : ZOOM_LEVELS) {
+        QVector<double> samples;
+        for (int page = 0; page < pageCount && samples.count() < RENDER_SAMPLES; page += step) {
+            const QSize size = (document->pageSize(page) * zoom * 96 / 72.0).toSize();
+            timer.restart();
+            const QImage image = RenderCache::renderPage(document, page, size);
+            samples.append( elapsedMsecs(timer) );
+            Q_UNUSED(image)
+        }
+        render.insert( QString::number(zoom), percentiles(samples) );
+    }
+    result.insert( QStringLiteral("render_ms"), render );
+
+    // search: index build, then lookups of a rare and a common word
+    QJsonObject search;
+    SearchEngine engine;
+    timer.restart();
+    engine.setDocument(document);
+    if (engine.isIndexing()) {
+        waitFor(&engine, &SearchEngine::indexFinished);
+    }
+    search.insert( QStringLiteral("index_ms"), elapsedMsecs(timer) );
+
+    // every search scans all the pages, until the count of matches is known
+    struct Query {
+        QString name;
+        QString text;
+        SearchEngine::SearchFlags flags;
+    };
+    const Query queries[] = {
+        { QLatin1String(PdfGenerator::SEARCH_MARKER), QLatin1String(PdfGenerator::SEARCH_MARKER), SearchEngine::SearchFlags() },
+        { QStringLiteral("lorem"),                    QStringLiteral("lorem"),                    SearchEngine::SearchFlags() },
+        { QStringLiteral("whole_words"),              QStringLiteral("lorem"),                    SearchEngine::WholeWords },
+        { QStringLiteral("ignore_diacritics"),        QStringLiteral("lorem"),                    SearchEngine::IgnoreDiacritics },
+        { QStringLiteral("substring"),                QStringLiteral("m ipsum d"),                SearchEngine::CaseSensitive },
+        { QStringLiteral("regex"),                    QStringLiteral("zyx\\w+|l\\w+m\\s+ipsum"),    SearchEngine::RegularExpression }
+    };
+    for (const Query &query : queries) {
+        QVector<double> samples;
+        for (int i = 0; i < SEARCH_SAMPLES; ++i) {
+            engine.stopSearch();
+            timer.restart();
+            engine.find(query.text, 0, true, query.flags);
+            if (engine.isScanning()) {
+                waitFor(&engine, &SearchEngine::scanFinished);
+            }
+            samples.append( elapsedMsecs(timer) );
+        }
+        search.insert( query.name, percentiles(samples) );
+    }
+    result.insert( QStringLiteral("search_ms"), search );
+
+    engine.clear();
+    cache.removeDocument(document);
+    delete document;
+
+    result.insert( QStringLiteral("peak_rss_kib"), peakRssKiB() );
+    return result;
+}
+
+
+// the kernels of every color mode, on the same page image
+static QJsonObject benchColorTransform()
+{
+    // opaque gray levels and some colors, as a text page has
+    QImage page(COLOR_IMAGE_SIZE, QImage::Format_ARGB32_Premultiplied);
+    for (int y = 0; y < page.height(); ++y) {
+        QRgb* line = reinterpret_cast<QRgb *>(page.scanLine(y));
+        for (int x = 0; x < page.width(); ++x) {
+            line[x] = (x * 7 + y * 13) % 97 ? qRgb(255, 255, 255) : qRgb(x % 256, y % 256, (x + y) % 256);
+        }
+    }
+
+    struct Mode {
+        QString name;
+        ColorTransform::Mode mode;
+    };
+    const Mode modes[] = {
+        { QStringLiteral("night"),         ColorTransform::Night },
+        { QStringLiteral("sepia"),         ColorTransform::Sepia },
+        { QStringLiteral("grayscale"),     ColorTransform::Grayscale },
+        { QStringLiteral("high_contrast"), ColorTransform::HighContrast }
+    };
+    struct Kernel {
+        QString name;
+        ColorTransform::Kernel kernel;
+    };
+    const Kernel kernels[] = {
+        { QStringLiteral("scalar"), ColorTransform::Scalar },
+        { QStringLiteral("sse2"),   ColorTransform::Sse2 },
+        { QStringLiteral("avx2"),   ColorTransform::Avx2 }
+    };
+
+    QJsonObject result;
+    result.insert( QStringLiteral("pixels"), COLOR_IMAGE_SIZE.width() * COLOR_IMAGE_SIZE.height() );
+    for (const Kernel &kernel : kernels) {
+        if (!ColorTransform::isSupported(kernel.kernel)) {
+            continue;
+        }
+        QJsonObject times;
+        for (const Mode &mode : modes) {
+            QVector<double> samples;
+            for (int i = 0; i < COLOR_SAMPLES; ++i) {
+                // a copy of its own: the pass does not detach while timed
+                QImage image = page.copy();
+                image.bits();
+
+                QElapsedTimer timer;
+                timer.start();
+                ColorTransform::apply(image, mode.mode, kernel.kernel);
+                samples.append( elapsedMsecs(timer) );
+            }
+            times.insert( mode.name, percentiles(samples) );
+        }
+        result.insert( kernel.name, times );
+    }
+    return result;
+}
+
+
+int main(int argc, char *argv[])
+{
+    // the benchmark never shows anything
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    QGuiApplication app(argc, argv);
+    QCoreApplication::setApplicationName( QStringLiteral("cuteviewer_bench") );
+    QCoreApplication::setApplicationVersion( QStringLiteral(PROJECT_VERSION) );
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription( QStringLiteral("Load, render, search and color transform benchmarks for cuteviewer.") );
+    parser.addHelpOption();
+    QCommandLineOption outputOption( QStringLiteral("output"),
+                                     QStringLiteral("Write the JSON report to <file> instead of stdout."),
+                                     QStringLiteral("file") );
+    QCommandLineOption pagesOption( QStringLiteral("long-pages"),
+                                    QStringLiteral("Pages of the long document (default: 10000)."),
+                                    QStringLiteral("n"), QStringLiteral("10000") );
+    parser.addOption(outputOption);
+    parser.addOption(pagesOption);
+    parser.process(app);
+
+    QTextStream err(stderr);
+
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        err << "cannot create a temporary directory" << Qt::endl;
+        return 1;
+    }
+
+    struct Sample {
+        QString name;
+        bool (*write)(const QString &, int);
+        int pages;
+    };
+    const Sample samples[] = {
+        { QStringLiteral("text"),  PdfGenerator::writeTextDocument,  200 },
+        { QStringLiteral("image"), PdfGenerator::writeImageDocument, 40 },
+        { QStringLiteral("long"),  PdfGenerator::writeLongDocument,  qMax(1, parser.value(pagesOption).toInt()) }
+    };
+
+    QJsonArray documents;
+    for (const Sample &sample : samples) {
+        const QString path = dir.filePath(sample.name + QLatin1String(".pdf"));
+        err << "generating " << sample.name << " document..." << Qt::endl;
+        if (!sample.write(path, sample.pages)) {
+            err << "cannot write " << path << Qt::endl;
+            return 1;
+        }
+        err << "measuring " << sample.name << " document..." << Qt::endl;
+        documents.append( benchDocument(sample.name, path) );
+    }
+
+    err << "measuring color transforms..." << Qt::endl;
+    const QJsonObject colorTransform = benchColorTransform();
+
+    QJsonObject report;
+    report.insert( QStringLiteral("version"), QStringLiteral(PROJECT_VERSION) );
+    report.insert( QStringLiteral("documents"), documents );
+    report.insert( QStringLiteral("color_transform_ms"), colorTransform );
+    report.insert( QStringLiteral("peak_rss_kib"), peakRssKiB() );
+
+    const QByteArray json = QJsonDocument(report).toJson();
+    if (!parser.isSet(outputOption)) {
+        QTextStream(stdout) << json << Qt::flush;
+        return 0;
+    }
+
+    QFile file( parser.value(outputOption) );
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+        err << "cannot write " << file.fileName() << Qt::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "pdfgenerator.h"
+
+#include <QImage>
+#include <QPageLayout>
+#include <QPageSize>
+#include <QPainter>
+#include <QPdfWriter>
+#include <QRandomGenerator>
+#include <QStringList>
+
+
+const char PdfGenerator::SEARCH_MARKER[] = "zyxwvut";
+
+
+static const int RESOLUTION = 300;
+
+
+static QString randomText(QRandomGenerator &random, int words)
+{
+    static const QStringList vocabulary = QStringLiteral(
+        "lorem ipsum dolor sit amet consectetur adipiscing elit sed do eiusmod tempor "
+        "incididunt ut labore et dolore magna aliqua enim ad minim veniam quis nostrud "
+        "exercitation ullamco laboris nisi aliquip ex ea commodo consequat duis aute irure "
+        "in reprehenderit voluptate velit esse cillum fugiat nulla pariatur excepteur sint "
+        "occaecat cupidatat non proident sunt culpa qui officia deserunt mollit anim id est laborum"
+    ).split(QLatin1Char(' '));
+
+    QStringList text;
+    for (int i = 0; i < words; ++i) {
+        text.append( vocabulary.at( random.bounded(vocabulary.count()) ) );
+    }
+    return text.join(QLatin1Char(' '));
+}
+
+
+static bool isMarkerPage(int page, int pages)
+{
+    return page == (pages * 3) / 4;
+}
+
+
+static void setupWriter(QPdfWriter &writer)
+{
+    writer.setPageLayout( QPageLayout(QPageSize(QPageSize::A4), QPageLayout::Portrait, QMarginsF()) );
+    writer.setResolution(RESOLUTION);
+    writer.setCreator( QStringLiteral("cuteviewer_bench") );
+}
+
+
+bool PdfGenerator::writeTextDocument(const QString &path, int pages)
+{
+    QPdfWriter writer(path);
+    setupWriter(writer);
+
+    QPainter painter;
+    if (!painter.begin(&writer)) {
+        return false;
+    }
+    painter.setFont( QFont(QStringLiteral("Serif"), 10) );
+
+    QRandomGenerator random(1);
+    const QRect area = painter.viewport().adjusted(RESOLUTION / 2, RESOLUTION / 2, -RESOLUTION / 2, -RESOLUTION / 2);
+    for (int page = 0; page < pages; ++page) {
+        if (page > 0) {
+            writer.newPage();
+        }
+        QString text = randomText(random, 600);
+        if (isMarkerPage(page, pages)) {
+            text += QLatin1Char(' ') + QLatin1String(SEARCH_MARKER);
+        }
+        painter.drawText(area, Qt::TextWordWrap, text);
+    }
+    return painter.end();
+}
+
+
+bool PdfGenerator::writeImageDocument(const QString &path, int pages)
+{
+    QPdfWriter writer(path);
+    setupWriter(writer);
+
+    QPainter painter;
+    if (!painter.begin(&writer)) {
+        return false;
+    }
+
+    QRandomGenerator random(2);
+    QImage image(800, 1100, QImage::Format_RGB32);
+    const QRect area = painter.viewport();
+    for (int page = 0; page < pages; ++page) {
+        if (page > 0) {
+            writer.newPage();
+        }
+
+        // noise does not compress: like a scanned page
+        for (int y = 0; y < image.height(); ++y) {
+            QRgb* line = reinterpret_cast<QRgb*>(image.scanLine(y));
+            for (int x = 0; x < image.width(); ++x) {
+                line[x] = random.generate() | 0xff000000;
+            }
+        }
+        painter.drawImage(area, image);
+
+        if (isMarkerPage(page, pages)) {
+            painter.drawText(area, Qt::AlignCenter, QLatin1String(SEARCH_MARKER));
+        }
+    }
+    return painter.end();
+}
+
+
+bool PdfGenerator::writeLongDocument(const QString &path, int pages)
+{
+    QPdfWriter writer(path);
+    setupWriter(writer);
+
+    QPainter painter;
+    if (!painter.begin(&writer)) {
+        return false;
+    }
+    painter.setFont( QFont(QStringLiteral("Serif"), 10) );
+
+    QRandomGenerator random(3);
+    const QRect area = painter.viewport().adjusted(RESOLUTION / 2, RESOLUTION / 2, -RESOLUTION / 2, -RESOLUTION / 2);
+    for (int page = 0; page < pages; ++page) {
+        if (page > 0) {
+            writer.newPage();
+        }
+        QString text = QString::number(page + 1) + QLatin1Char(' ') + randomText(random, 12);
+        if (isMarkerPage(page, pages)) {
+            text += QLatin1Char(' ') + QLatin1String(SEARCH_MARKER);
+        }
+        painter.drawText(area, Qt::AlignTop | Qt::AlignLeft, text);
+    }
+    return painter.end();
+}
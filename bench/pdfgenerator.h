@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef PDFGENERATOR_H
+#define PDFGENERATOR_H
+
+
+#include <QString>
+
+
+// Synthetic documents for the benchmarks.
+// Contents are pseudo random, but always the same for the same arguments.
+// Each document has the word SEARCH_MARKER on one page, three quarters in.
+namespace PdfGenerator
+{
+    extern const char SEARCH_MARKER[];
+
+    // pages full of wrapped text
+    bool writeTextDocument(const QString &path, int pages);
+
+    // a full page noise image on each page
+    bool writeImageDocument(const QString &path, int pages);
+
+    // lots of pages with a single line of text
+    bool writeLongDocument(const QString &path, int pages);
+}
+
+#endif // PDFGENERATOR_H
@@ -8,14 +8,73 @@
 
 
 #include "application.h"
+#include "batchrenderer.h"
+#include "config.h"
+#include "documentregistry.h"
+#include "historystore.h"
 #include "mainwindow.h"
+#include "memorygovernor.h"
+#include "rendercache.h"
+#include "settingsstore.h"
+#include "startuptrace.h"
+#include "textextractor.h"
+#include "tracing.h"
 
 #include <QCommandLineParser>
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QStandardPaths>
+#include <QTextStream>
+#include <QTimer>
+
+#include <cstdlib>
 
 
 Application::Application(int &argc, char *argv[])
     : QApplication(argc,argv)
+    , _server(nullptr)
+    , _fileWatcher(nullptr)
+    , _rewatchTimer(nullptr)
+    , _settings(nullptr)
+    , _renderCache(nullptr)
+    , _documentRegistry(nullptr)
+    , _memoryGovernor(nullptr)
+    , _historyStore(nullptr)
+{
+}
+
+
+Application::~Application()
+{
+    // QSettings needs the application name: not later than here
+    if (_settings) {
+        _settings->sync();
+    }
+}
+
+
+void Application::createServices()
+{
+    _settings = new SettingsStore(this);
+    _renderCache = new RenderCache(this);
+    _documentRegistry = new DocumentRegistry(_renderCache, this);
+
+    // created after the render cache, to be deleted after it too
+    _memoryGovernor = new MemoryGovernor(this);
+    _renderCache->setMemoryGovernor(_memoryGovernor);
+
+    const QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    _historyStore = new HistoryStore(dataDir + QLatin1String("/history"), this);
+}
+
+
+Application* Application::instance()
 {
+    return static_cast<Application*>(QCoreApplication::instance());
 }
 
 
@@ -25,6 +84,80 @@ void Application::removeWindowFromList(MainWindow* w)
 }
 
 
+void Application::addWatchedPath(const QString& path)
+{
+    if (path.isEmpty()) {
+        return;
+    }
+
+    if (!_fileWatcher) {
+        _fileWatcher = new QFileSystemWatcher(this);
+        connect(_fileWatcher, &QFileSystemWatcher::fileChanged, this, &Application::onFileChanged);
+
+        _rewatchTimer = new QTimer(this);
+        _rewatchTimer->setInterval(1000);
+        connect(_rewatchTimer, &QTimer::timeout, this, &Application::rewatchMissingPaths);
+    }
+
+    if (_watchedPaths[path]++ == 0) {
+        _fileWatcher->addPath(path);
+    }
+}
+
+
+void Application::removeWatchedPath(const QString& path)
+{
+    auto it = _watchedPaths.find(path);
+    if (it == _watchedPaths.end()) {
+        return;
+    }
+
+    if (--it.value() == 0) {
+        _watchedPaths.erase(it);
+        _fileWatcher->removePath(path);
+    }
+}
+
+
+void Application::onFileChanged(const QString& path)
+{
+    // files removed, or replaced by a rename, are not watched anymore:
+    // the new one is, as soon as it is there
+    if (!_fileWatcher->files().contains(path)) {
+        if (QFileInfo::exists(path)) {
+            _fileWatcher->addPath(path);
+        } else {
+            _rewatchTimer->start();
+        }
+    }
+
+    Q_EMIT watchedFileChanged(path);
+}
+
+
+void Application::rewatchMissingPaths()
+{
+    const QStringList watched = _fileWatcher->files();
+
+    bool missing = false;
+    for (auto it = _watchedPaths.constBegin(); it != _watchedPaths.constEnd(); ++it) {
+        const QString &path = it.key();
+        if (watched.contains(path)) {
+            continue;
+        }
+        if (QFileInfo::exists(path) && _fileWatcher->addPath(path)) {
+            Q_EMIT watchedFileChanged(path);
+        } else {
+            missing = true;
+        }
+    }
+
+    if (!missing) {
+        _rewatchTimer->stop();
+    }
+}
+
+
 void Application::parseCommandlineArgs()
 {
     QCommandLineParser parser;
@@ -32,10 +165,216 @@ void Application::parseCommandlineArgs()
     parser.addHelpOption();
     parser.addVersionOption();
     parser.addPositionalArgument( QStringLiteral("file"), QStringLiteral("The file(s) to open.") );
+
+    // headless mode(s)
+    QCommandLineOption renderOption( QStringLiteral("render"),
+                                     QStringLiteral("Render the pages of the file(s) as images in <dir>, without opening any window."),
+                                     QStringLiteral("dir") );
+    QCommandLineOption extractTextOption( QStringLiteral("extract-text"),
+                                          QStringLiteral("Write the text of the file(s) on the standard output, without opening any window.") );
+    QCommandLineOption dpiOption( QStringLiteral("dpi"),
+                                  QStringLiteral("Resolution of the rendered pages (default: 150)."),
+                                  QStringLiteral("dpi") );
+    QCommandLineOption pagesOption( QStringLiteral("pages"),
+                                    QStringLiteral("The pages to render or extract, as first-last (default: all)."),
+                                    QStringLiteral("range") );
+    QCommandLineOption jobsOption( QStringLiteral("jobs"),
+                                   QStringLiteral("Number of parallel jobs (default: one per core). "
+                                                  "With --render, pages are still rasterized one at a time: "
+                                                  "the jobs encode the images."),
+                                   QStringLiteral("n") );
+    QCommandLineOption newInstanceOption( QStringLiteral("new-instance"),
+                                          QStringLiteral("Do not open the file(s) in the running instance.") );
+    parser.addOption(newInstanceOption);
+
+    QCommandLineOption startupTraceOption( QStringLiteral("startup-trace"),
+                                           QStringLiteral("Print the startup timeline on stderr.") );
+    parser.addOption(startupTraceOption);
+
+    QCommandLineOption traceOption( QStringLiteral("trace"),
+                                    QStringLiteral("Save timing spans to <file>, in the Chrome trace format."),
+                                    QStringLiteral("file") );
+    parser.addOption(traceOption);
+
+    QCommandLineOption formatOption( QStringLiteral("format"),
+                                     QStringLiteral("Output format: png or ppm for --render (default: png), "
+                                                    "txt or jsonl for --extract-text (default: txt)."),
+                                     QStringLiteral("format") );
+    parser.addOption(renderOption);
+    parser.addOption(extractTextOption);
+    parser.addOption(dpiOption);
+    parser.addOption(pagesOption);
+    parser.addOption(jobsOption);
+    parser.addOption(formatOption);
+
     parser.process(*this);
 
+    if (parser.isSet(startupTraceOption)) {
+        StartupTrace::setEnabled(true);
+    }
+    if (parser.isSet(traceOption)) {
+        Trace::start( parser.value(traceOption) );
+    }
+
+    if (parser.isSet(renderOption)) {
+        BatchRenderer renderer;
+        renderer.setOutputDir( parser.value(renderOption) );
+        if (parser.isSet(dpiOption)) {
+            renderer.setDpi( qMax(1, parser.value(dpiOption).toInt()) );
+        }
+        if (parser.isSet(jobsOption)) {
+            renderer.setJobs( parser.value(jobsOption).toInt() );
+        }
+        if (parser.isSet(pagesOption) && !renderer.setPageRange( parser.value(pagesOption) )) {
+            QTextStream(stderr) << tr("Invalid page range: %1").arg( parser.value(pagesOption) ) << Qt::endl;
+            ::exit(1);
+        }
+        if (parser.isSet(formatOption) && !renderer.setFormat( parser.value(formatOption) )) {
+            QTextStream(stderr) << tr("Invalid format: %1").arg( parser.value(formatOption) ) << Qt::endl;
+            ::exit(1);
+        }
+
+        // no window is created: the event loop just runs the batch and quits
+        const QStringList files = parser.positionalArguments();
+        QTimer::singleShot(0, this, [=] () {
+                exit( renderer.run(files) );
+            }
+        );
+        return;
+    }
+
+    if (parser.isSet(extractTextOption)) {
+        TextExtractor extractor;
+        if (parser.isSet(jobsOption)) {
+            extractor.setJobs( parser.value(jobsOption).toInt() );
+        }
+        if (parser.isSet(pagesOption) && !extractor.setPageRange( parser.value(pagesOption) )) {
+            QTextStream(stderr) << tr("Invalid page range: %1").arg( parser.value(pagesOption) ) << Qt::endl;
+            ::exit(1);
+        }
+        if (parser.isSet(formatOption) && !extractor.setFormat( parser.value(formatOption) )) {
+            QTextStream(stderr) << tr("Invalid format: %1").arg( parser.value(formatOption) ) << Qt::endl;
+            ::exit(1);
+        }
+
+        const QStringList files = parser.positionalArguments();
+        QTimer::singleShot(0, this, [=] () {
+                exit( extractor.run(files) );
+            }
+        );
+        return;
+    }
+
+    // the running instance has a different working directory
+    QStringList paths;
     const QStringList posArgs = parser.positionalArguments();
-    loadPaths(posArgs);
+    for (const QString &file : posArgs) {
+        paths.append( QFileInfo(file).absoluteFilePath() );
+    }
+
+    if (!parser.isSet(newInstanceOption)) {
+        if (sendToRunningInstance(paths)) {
+            QTimer::singleShot(0, this, &QCoreApplication::quit);
+            return;
+        }
+        startServer();
+    }
+
+    // not built at all when the files went to the running instance
+    createServices();
+    StartupTrace::mark( QStringLiteral("services") );
+
+    // ready by the time the first document is loaded
+    _historyStore->load();
+
+    loadSettings();
+
+    loadPaths(paths);
+}
+
+
+QString Application::serverName()
+{
+    // a per user socket
+    const QString runtimeDir = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if (!runtimeDir.isEmpty()) {
+        return QDir(runtimeDir).filePath( QStringLiteral(PROJECT_NAME ".socket") );
+    }
+    return QStringLiteral(PROJECT_NAME "-") + QString::fromLocal8Bit( qgetenv("USER") );
+}
+
+
+bool Application::sendToRunningInstance(const QStringList& paths)
+{
+    QLocalSocket socket;
+    socket.connectToServer( serverName() );
+    if (!socket.waitForConnected(500)) {
+        return false;
+    }
+
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_15);
+    out << paths;
+    socket.write(data);
+
+    // the running instance answers once it got the paths: without
+    // the answer (it may be hanging) the files are opened here
+    return socket.waitForBytesWritten(1000) && socket.waitForReadyRead(2000);
+}
+
+
+void Application::startServer()
+{
+    _server = new QLocalServer(this);
+    _server->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(_server, &QLocalServer::newConnection, this, &Application::onNewConnection);
+
+    if (_server->listen( serverName() )) {
+        return;
+    }
+
+    // the socket of a crashed instance is removed, not the one of an
+    // instance too busy to answer: the files would be opened twice
+    QLocalSocket probe;
+    probe.connectToServer( serverName() );
+    if (probe.waitForConnected(500) || (probe.error() != QLocalSocket::ConnectionRefusedError
+                                        && probe.error() != QLocalSocket::ServerNotFoundError)) {
+        delete _server;
+        _server = nullptr;
+        return;
+    }
+
+    QLocalServer::removeServer( serverName() );
+    if (!_server->listen( serverName() )) {
+        delete _server;
+        _server = nullptr;
+    }
+}
+
+
+void Application::onNewConnection()
+{
+    while (QLocalSocket* socket = _server->nextPendingConnection()) {
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QLocalSocket::readyRead, this, [=] () {
+                QDataStream in(socket);
+                in.setVersion(QDataStream::Qt_5_15);
+                in.startTransaction();
+
+                QStringList paths;
+                in >> paths;
+                if (!in.commitTransaction()) {
+                    // wait for the rest of the data
+                    return;
+                }
+
+                socket->write("1");
+                socket->flush();
+                loadPaths(paths);
+            }
+        );
+    }
 }
 
 
@@ -52,7 +391,7 @@ void Application::loadPaths(const QStringList& paths)
 }
 
 
-void Application::loadPath(const QString& path)
+void Application::loadPath(const QString& path, int page)
 {
     if (path.isEmpty()) {
         MainWindow *mainWin = new MainWindow;
@@ -63,6 +402,7 @@ void Application::loadPath(const QString& path)
 
     for (MainWindow* win : qAsConst(_windows)) {
         if (win->filePath() == path) {
+            win->showPage(page);
             win->activateWindow();
             win->raise();
             return;
@@ -72,13 +412,38 @@ void Application::loadPath(const QString& path)
     MainWindow *mainWin = new MainWindow;
     _windows.append(mainWin);
     mainWin->show();
-    mainWin->loadFilePath(path);
+    mainWin->loadFilePath(path, page);
 }
 
 
 void Application::loadSettings()
 {
-    for (MainWindow* win : qAsConst(_windows)) {
-        win->loadSettings();
+    TRACE_SCOPE("settings", "load settings");
+
+    applySettings( QStringList() << QStringLiteral("RenderCacheSize")
+                                 << QStringLiteral("DiskCacheSize")
+                                 << QStringLiteral("MemoryBudget") );
+
+    // every window follows its own settings
+    connect(_settings, &SettingsStore::changed, this, &Application::applySettings, Qt::UniqueConnection);
+}
+
+
+void Application::applySettings(const QStringList &keys)
+{
+    if (keys.contains( QStringLiteral("RenderCacheSize") )) {
+        const int cacheSize = _settings->value( QStringLiteral("RenderCacheSize"), 256).toInt();
+        _renderCache->setBudget( qint64(cacheSize) * 1024 * 1024 );
+    }
+
+    if (keys.contains( QStringLiteral("DiskCacheSize") )) {
+        const int diskCacheSize = _settings->value( QStringLiteral("DiskCacheSize"), 1024).toInt();
+        _renderCache->setDiskBudget( qint64(diskCacheSize) * 1024 * 1024 );
+    }
+
+    // 0 leaves the limit of the cgroup, if any
+    if (keys.contains( QStringLiteral("MemoryBudget") )) {
+        const int memoryBudget = _settings->value( QStringLiteral("MemoryBudget"), 0).toInt();
+        _memoryGovernor->setBudget( qint64(memoryBudget) * 1024 * 1024 );
     }
 }
@@ -12,8 +12,18 @@
 
 
 #include <QApplication>
+#include <QHash>
 
+class QFileSystemWatcher;
+class QLocalServer;
+class QTimer;
+
+class DocumentRegistry;
+class HistoryStore;
 class MainWindow;
+class MemoryGovernor;
+class RenderCache;
+class SettingsStore;
 
 
 class Application : public QApplication
@@ -23,17 +33,66 @@ class Application : public QApplication
 public:
     Application(int &argc, char *argv[]);
 
+    // writes the pending settings
+    ~Application();
+
+    static Application* instance();
+
     void parseCommandlineArgs();
 
     void loadPaths(const QStringList& paths);
-    void loadPath(const QString& path);
+    // page (counting from 0) is shown once the file is loaded
+    void loadPath(const QString& path, int page = -1);
 
     void removeWindowFromList(MainWindow* w);
 
+    // the files of the open documents: a path is watched until
+    // every window that added it removes it
+    void addWatchedPath(const QString& path);
+    void removeWatchedPath(const QString& path);
+
     void loadSettings();
 
+    inline SettingsStore* settings() const { return _settings; }
+    inline RenderCache* renderCache() const { return _renderCache; }
+    inline DocumentRegistry* documentRegistry() const { return _documentRegistry; }
+    inline MemoryGovernor* memoryGovernor() const { return _memoryGovernor; }
+    inline HistoryStore* historyStore() const { return _historyStore; }
+
+Q_SIGNALS:
+    void watchedFileChanged(const QString& path);
+
+private:
+    // single instance: later launches hand their paths to the first one
+    static QString serverName();
+    bool sendToRunningInstance(const QStringList& paths);
+    void startServer();
+
+    // what the windows share, built once the files are not forwarded
+    void createServices();
+
+private Q_SLOTS:
+    void onNewConnection();
+    void onFileChanged(const QString& path);
+    void rewatchMissingPaths();
+    void applySettings(const QStringList &keys);
+
 private:
     QList<MainWindow*> _windows;
+
+    QLocalServer* _server;
+
+    QFileSystemWatcher* _fileWatcher;
+    QHash<QString, int> _watchedPaths;
+
+    // looks for the watched files removed, until they are back
+    QTimer* _rewatchTimer;
+
+    SettingsStore* _settings;
+    RenderCache* _renderCache;
+    DocumentRegistry* _documentRegistry;
+    MemoryGovernor* _memoryGovernor;
+    HistoryStore* _historyStore;
 };
 
 #endif // APPLICATION_H
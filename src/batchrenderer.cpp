@@ -0,0 +1,197 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "batchrenderer.h"
+
+#include "rendercache.h"
+
+#include <QtConcurrent>
+
+#include <QDir>
+#include <QFileInfo>
+#include <QSet>
+#include <QTextStream>
+#include <QThreadPool>
+
+#include <QPdfDocument>
+
+#include <climits>
+
+
+// documents kept open at the same time: while the pages of one
+// are rendered, the next one is already loaded
+static const int OPEN_DOCUMENTS = 2;
+
+
+struct OpenDocument
+{
+    QPdfDocument* document;
+    QString path;
+    QList<QFuture<bool> > pages;
+};
+
+
+static bool renderPage(QPdfDocument *document, int page, int dpi, const QString &fileName, const QString &format)
+{
+    const QSize size = (document->pageSize(page) * dpi / 72.0).toSize();
+    const QImage image = RenderCache::renderPage(document, page, size);
+    if (image.isNull()) {
+        return false;
+    }
+
+    // the page is opaque: no need to save an alpha channel
+    return image.convertToFormat(QImage::Format_RGB32).save(fileName, format.toLatin1().constData());
+}
+
+
+// the names of the images of each file, all different
+static QStringList outputNames(const QStringList &files)
+{
+    QStringList names;
+    QSet<QString> used;
+    for (const QString &path : files) {
+        const QString baseName = QFileInfo(path).completeBaseName();
+        QString name = baseName;
+        for (int n = 2; used.contains(name); ++n) {
+            name = baseName + QLatin1Char('_') + QString::number(n);
+        }
+        used.insert(name);
+        names.append(name);
+    }
+    return names;
+}
+
+
+// waits for the pages of doc, then closes it. Returns the failed pages
+static int finish(const OpenDocument &doc)
+{
+    int failures = 0;
+    for (const QFuture<bool> &future : doc.pages) {
+        if (!future.result()) {
+            ++failures;
+        }
+    }
+    delete doc.document;
+
+    if (failures) {
+        QTextStream(stderr) << BatchRenderer::tr("%1: %2 pages not rendered").arg(doc.path).arg(failures) << Qt::endl;
+    }
+    return failures;
+}
+
+
+BatchRenderer::BatchRenderer()
+    : _outputDir( QStringLiteral(".") )
+    , _format( QStringLiteral("png") )
+    , _dpi(150)
+    , _jobs(QThread::idealThreadCount())
+    , _firstPage(1)
+    , _lastPage(INT_MAX)
+{
+}
+
+
+bool BatchRenderer::setFormat(const QString &format)
+{
+    const QString f = format.toLower();
+    if (f != QLatin1String("png") && f != QLatin1String("ppm")) {
+        return false;
+    }
+    _format = f;
+    return true;
+}
+
+
+bool BatchRenderer::setPageRange(const QString &range)
+{
+    return parsePageRange(range, &_firstPage, &_lastPage);
+}
+
+
+bool BatchRenderer::parsePageRange(const QString &range, int *first, int *last)
+{
+    const QStringList parts = range.split(QLatin1Char('-'));
+    if (parts.count() > 2) {
+        return false;
+    }
+
+    bool ok;
+    const int firstPage = parts.at(0).toInt(&ok);
+    if (!ok || firstPage < 1) {
+        return false;
+    }
+
+    int lastPage = firstPage;
+    if (parts.count() == 2) {
+        lastPage = parts.at(1).isEmpty() ? INT_MAX : parts.at(1).toInt(&ok);
+        if (!ok || lastPage < firstPage) {
+            return false;
+        }
+    }
+
+    *first = firstPage;
+    *last = lastPage;
+    return true;
+}
+
+
+int BatchRenderer::run(const QStringList &files) const
+{
+    QTextStream err(stderr);
+
+    QDir dir(_outputDir);
+    if (!dir.mkpath( QStringLiteral(".") )) {
+        err << tr("Cannot create directory %1").arg(_outputDir) << Qt::endl;
+        return 1;
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount( qMax(1, _jobs) );
+
+    int failures = 0;
+    QList<OpenDocument> open;
+
+    const QStringList names = outputNames(files);
+    for (int i = 0; i < files.count(); ++i) {
+        const QString &path = files.at(i);
+        if (names.at(i) != QFileInfo(path).completeBaseName()) {
+            err << tr("%1: pages saved as %2-NNNN.%3, the name is taken").arg(path, names.at(i), _format) << Qt::endl;
+        }
+
+        if (open.count() == OPEN_DOCUMENTS) {
+            failures += finish( open.takeFirst() );
+        }
+
+        OpenDocument doc;
+        doc.document = new QPdfDocument;
+        doc.path = path;
+        if (doc.document->load(path) != QPdfDocument::NoError) {
+            err << tr("Cannot open %1").arg(path) << Qt::endl;
+            delete doc.document;
+            ++failures;
+            continue;
+        }
+
+        const QString baseName = dir.filePath( names.at(i) );
+        const int last = qMin(_lastPage, doc.document->pageCount());
+        for (int page = _firstPage; page <= last; ++page) {
+            const QString fileName = baseName + QLatin1Char('-')
+                                   + QStringLiteral("%1").arg(page, 4, 10, QLatin1Char('0'))
+                                   + QLatin1Char('.') + _format;
+            doc.pages.append( QtConcurrent::run(&pool, renderPage, doc.document, page - 1, _dpi, fileName, _format) );
+        }
+        open.append(doc);
+    }
+
+    while (!open.isEmpty()) {
+        failures += finish( open.takeFirst() );
+    }
+
+    return failures ? 1 : 0;
+}
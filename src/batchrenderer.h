@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef BATCHRENDERER_H
+#define BATCHRENDERER_H
+
+
+#include <QCoreApplication>
+#include <QString>
+#include <QStringList>
+
+
+// Renders the pages of documents to image files, without any window.
+// Pages are rendered and encoded by a thread pool, while the next
+// document is opened: the pool never waits for a document to be loaded.
+// The PDF library renders one page at a time, whatever the thread:
+// only the encoding of the images runs on several cores.
+// Pages are saved as <name>-NNNN.<format>, name being the file name
+// without its extension: files with the same name get _2, _3... after it.
+class BatchRenderer
+{
+    Q_DECLARE_TR_FUNCTIONS(BatchRenderer)
+
+public:
+    BatchRenderer();
+
+    inline void setOutputDir(const QString &dir) { _outputDir = dir; }
+    inline void setDpi(int dpi) { _dpi = dpi; }
+    inline void setJobs(int jobs) { _jobs = jobs; }
+
+    // png or ppm
+    bool setFormat(const QString &format);
+
+    // first-last, first-, or a single page, counting from 1
+    bool setPageRange(const QString &range);
+
+    // returns the process exit code
+    int run(const QStringList &files) const;
+
+    // parses a page range as setPageRange() wants it (last is INT_MAX for first-)
+    static bool parsePageRange(const QString &range, int *first, int *last);
+
+private:
+    QString _outputDir;
+    QString _format;
+    int _dpi;
+    int _jobs;
+    int _firstPage;
+    int _lastPage;
+};
+
+#endif // BATCHRENDERER_H
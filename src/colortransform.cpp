@@ -0,0 +1,285 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "colortransform.h"
+
+#include "tracing.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define COLORTRANSFORM_SSE2
+#endif
+
+// AVX2 is built for a single function, and chosen at run time
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define COLORTRANSFORM_AVX2
+#endif
+
+
+// The same integer formulas, in every kernel:
+// luma y = (77 r + 150 g + 29 b) >> 8
+// night: each color becomes alpha - color
+// sepia: r = y, g = y * 240 / 256, b = y * 196 / 256
+// high contrast: (y - 48) * 51 / 32, clamped to 0..alpha
+
+
+typedef void (*RowFunction)(quint32 *pixels, int count);
+
+
+template <int Mode>
+static inline quint32 transformPixel(quint32 p)
+{
+    const quint32 alpha = p & 0xff000000;
+    const quint32 a = p >> 24;
+
+    if (Mode == ColorTransform::Night) {
+        return ((a * 0x010101) - (p & 0x00ffffff)) | alpha;
+    }
+
+    const quint32 y = (((p >> 16) & 0xff) * 77 + ((p >> 8) & 0xff) * 150 + (p & 0xff) * 29) >> 8;
+
+    if (Mode == ColorTransform::Sepia) {
+        return alpha | (y << 16) | (((y * 240) >> 8) << 8) | ((y * 196) >> 8);
+    }
+    if (Mode == ColorTransform::HighContrast) {
+        quint32 t = y > 48 ? y - 48 : 0;
+        t = qMin( qMin((t * 51) >> 5, 255u), a );
+        return alpha | (t * 0x010101);
+    }
+    return alpha | (y * 0x010101);
+}
+
+
+template <int Mode>
+static void transformScalar(quint32 *pixels, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        pixels[i] = transformPixel<Mode>(pixels[i]);
+    }
+}
+
+
+#ifdef COLORTRANSFORM_SSE2
+
+// every value is kept in the low 16 bits of its 32 bit lane,
+// so that the 16 bit multiplications give 32 bit results
+template <int Mode>
+static inline __m128i transformSse2(__m128i p)
+{
+    const __m128i colorMask = _mm_set1_epi32(0x00ffffff);
+    const __m128i byteMask = _mm_set1_epi32(0xff);
+    const __m128i alpha = _mm_andnot_si128(colorMask, p);
+    const __m128i a = _mm_srli_epi32(p, 24);
+
+    if (Mode == ColorTransform::Night) {
+        const __m128i aaa = _mm_or_si128( a, _mm_or_si128(_mm_slli_epi32(a, 8), _mm_slli_epi32(a, 16)) );
+        return _mm_or_si128( _mm_sub_epi32(aaa, _mm_and_si128(p, colorMask)), alpha );
+    }
+
+    const __m128i r = _mm_and_si128(_mm_srli_epi32(p, 16), byteMask);
+    const __m128i g = _mm_and_si128(_mm_srli_epi32(p, 8), byteMask);
+    const __m128i b = _mm_and_si128(p, byteMask);
+    const __m128i y = _mm_srli_epi32( _mm_add_epi32( _mm_add_epi32( _mm_mullo_epi16(r, _mm_set1_epi32(77)),
+                                                                    _mm_mullo_epi16(g, _mm_set1_epi32(150)) ),
+                                                     _mm_mullo_epi16(b, _mm_set1_epi32(29)) ), 8 );
+
+    __m128i red = y;
+    __m128i green = y;
+    __m128i blue = y;
+    if (Mode == ColorTransform::Sepia) {
+        green = _mm_srli_epi32(_mm_mullo_epi16(y, _mm_set1_epi32(240)), 8);
+        blue = _mm_srli_epi32(_mm_mullo_epi16(y, _mm_set1_epi32(196)), 8);
+    } else if (Mode == ColorTransform::HighContrast) {
+        __m128i t = _mm_subs_epu16(y, _mm_set1_epi32(48));
+        t = _mm_srli_epi32(_mm_mullo_epi16(t, _mm_set1_epi32(51)), 5);
+        t = _mm_min_epi16( _mm_min_epi16(t, byteMask), a );
+        red = green = blue = t;
+    }
+
+    return _mm_or_si128( _mm_or_si128(alpha, _mm_slli_epi32(red, 16)),
+                         _mm_or_si128(_mm_slli_epi32(green, 8), blue) );
+}
+
+
+template <int Mode>
+static void transformRowSse2(quint32 *pixels, int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i *v = reinterpret_cast<__m128i *>(pixels + i);
+        _mm_storeu_si128( v, transformSse2<Mode>(_mm_loadu_si128(v)) );
+    }
+    transformScalar<Mode>(pixels + i, count - i);
+}
+
+#endif // COLORTRANSFORM_SSE2
+
+
+#ifdef COLORTRANSFORM_AVX2
+
+// the SSE2 kernel, on eight pixels
+template <int Mode>
+__attribute__((target("avx2")))
+static inline __m256i transformAvx2(__m256i p)
+{
+    const __m256i colorMask = _mm256_set1_epi32(0x00ffffff);
+    const __m256i byteMask = _mm256_set1_epi32(0xff);
+    const __m256i alpha = _mm256_andnot_si256(colorMask, p);
+    const __m256i a = _mm256_srli_epi32(p, 24);
+
+    if (Mode == ColorTransform::Night) {
+        const __m256i aaa = _mm256_or_si256( a, _mm256_or_si256(_mm256_slli_epi32(a, 8), _mm256_slli_epi32(a, 16)) );
+        return _mm256_or_si256( _mm256_sub_epi32(aaa, _mm256_and_si256(p, colorMask)), alpha );
+    }
+
+    const __m256i r = _mm256_and_si256(_mm256_srli_epi32(p, 16), byteMask);
+    const __m256i g = _mm256_and_si256(_mm256_srli_epi32(p, 8), byteMask);
+    const __m256i b = _mm256_and_si256(p, byteMask);
+    const __m256i y = _mm256_srli_epi32( _mm256_add_epi32( _mm256_add_epi32( _mm256_mullo_epi16(r, _mm256_set1_epi32(77)),
+                                                                             _mm256_mullo_epi16(g, _mm256_set1_epi32(150)) ),
+                                                           _mm256_mullo_epi16(b, _mm256_set1_epi32(29)) ), 8 );
+
+    __m256i red = y;
+    __m256i green = y;
+    __m256i blue = y;
+    if (Mode == ColorTransform::Sepia) {
+        green = _mm256_srli_epi32(_mm256_mullo_epi16(y, _mm256_set1_epi32(240)), 8);
+        blue = _mm256_srli_epi32(_mm256_mullo_epi16(y, _mm256_set1_epi32(196)), 8);
+    } else if (Mode == ColorTransform::HighContrast) {
+        __m256i t = _mm256_subs_epu16(y, _mm256_set1_epi32(48));
+        t = _mm256_srli_epi32(_mm256_mullo_epi16(t, _mm256_set1_epi32(51)), 5);
+        t = _mm256_min_epi16( _mm256_min_epi16(t, byteMask), a );
+        red = green = blue = t;
+    }
+
+    return _mm256_or_si256( _mm256_or_si256(alpha, _mm256_slli_epi32(red, 16)),
+                            _mm256_or_si256(_mm256_slli_epi32(green, 8), blue) );
+}
+
+
+template <int Mode>
+__attribute__((target("avx2")))
+static void transformRowAvx2(quint32 *pixels, int count)
+{
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i *v = reinterpret_cast<__m256i *>(pixels + i);
+        _mm256_storeu_si256( v, transformAvx2<Mode>(_mm256_loadu_si256(v)) );
+    }
+    transformScalar<Mode>(pixels + i, count - i);
+}
+
+#endif // COLORTRANSFORM_AVX2
+
+
+static RowFunction rowFunction(ColorTransform::Mode mode, ColorTransform::Kernel kernel)
+{
+    static const RowFunction scalarRows[] = {
+        nullptr,
+        transformScalar<ColorTransform::Night>,
+        transformScalar<ColorTransform::Sepia>,
+        transformScalar<ColorTransform::Grayscale>,
+        transformScalar<ColorTransform::HighContrast>
+    };
+#ifdef COLORTRANSFORM_SSE2
+    static const RowFunction sse2Rows[] = {
+        nullptr,
+        transformRowSse2<ColorTransform::Night>,
+        transformRowSse2<ColorTransform::Sepia>,
+        transformRowSse2<ColorTransform::Grayscale>,
+        transformRowSse2<ColorTransform::HighContrast>
+    };
+    if (kernel == ColorTransform::Sse2) {
+        return sse2Rows[mode];
+    }
+#endif
+#ifdef COLORTRANSFORM_AVX2
+    static const RowFunction avx2Rows[] = {
+        nullptr,
+        transformRowAvx2<ColorTransform::Night>,
+        transformRowAvx2<ColorTransform::Sepia>,
+        transformRowAvx2<ColorTransform::Grayscale>,
+        transformRowAvx2<ColorTransform::HighContrast>
+    };
+    if (kernel == ColorTransform::Avx2) {
+        return avx2Rows[mode];
+    }
+#endif
+    Q_UNUSED(kernel)
+    return scalarRows[mode];
+}
+
+
+ColorTransform::Mode ColorTransform::mode(int value)
+{
+    if (value < Normal || value > HighContrast) {
+        return Normal;
+    }
+    return Mode(value);
+}
+
+
+bool ColorTransform::isSupported(Kernel kernel)
+{
+    switch (kernel) {
+    case Scalar:
+        return true;
+    case Sse2:
+#ifdef COLORTRANSFORM_SSE2
+        return true;
+#else
+        return false;
+#endif
+    case Avx2:
+#ifdef COLORTRANSFORM_AVX2
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+
+ColorTransform::Kernel ColorTransform::bestKernel()
+{
+    static const Kernel best = isSupported(Avx2) ? Avx2 : (isSupported(Sse2) ? Sse2 : Scalar);
+    return best;
+}
+
+
+void ColorTransform::apply(QImage &image, Mode mode)
+{
+    apply(image, mode, bestKernel());
+}
+
+
+void ColorTransform::apply(QImage &image, Mode mode, Kernel kernel)
+{
+    if (mode == Normal || image.isNull()) {
+        return;
+    }
+
+    TRACE_SCOPE_ARG("render", "color transform", "mode", int(mode));
+
+    if (image.format() != QImage::Format_ARGB32_Premultiplied) {
+        image = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    }
+    if (!isSupported(kernel)) {
+        kernel = Scalar;
+    }
+
+    // rows are transformed one by one: lines may be padded
+    const RowFunction transformRow = rowFunction(mode, kernel);
+    const int width = image.width();
+    for (int y = 0; y < image.height(); ++y) {
+        transformRow(reinterpret_cast<quint32 *>(image.scanLine(y)), width);
+    }
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef COLORTRANSFORM_H
+#define COLORTRANSFORM_H
+
+
+#include <QImage>
+
+
+// The reading modes, applied to the rendered pages.
+// Pixels are transformed in place, four (SSE2) or eight (AVX2) at a time
+// when the CPU can, by kernels giving the same result of the scalar one.
+// Alpha is kept, and the colors never exceed it: images stay premultiplied.
+class ColorTransform
+{
+public:
+    // values are saved in the settings
+    enum Mode {
+        Normal = 0,
+        Night,
+        Sepia,
+        Grayscale,
+        HighContrast
+    };
+
+    enum Kernel {
+        Scalar = 0,
+        Sse2,
+        Avx2
+    };
+
+    // the mode saved as value, Normal if unknown
+    static Mode mode(int value);
+
+    static bool isSupported(Kernel kernel);
+    static Kernel bestKernel();
+
+    // images not in ARGB32 premultiplied format are converted first
+    static void apply(QImage &image, Mode mode);
+    static void apply(QImage &image, Mode mode, Kernel kernel);
+};
+
+#endif // COLORTRANSFORM_H
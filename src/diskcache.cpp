@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "diskcache.h"
+
+#include "tracing.h"
+
+#include <QtConcurrent>
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <cstring>
+
+
+// the file format
+static const quint32 DISKCACHE_MAGIC = 0x43565047;
+static const quint32 DISKCACHE_VERSION = 1;
+
+// images waiting to be written, at most
+static const qint64 MAX_QUEUED_BYTES = 128 * 1024 * 1024;
+
+
+DiskCache::DiskCache(const QString &directory)
+    : _directory(directory)
+    , _budget(0)
+    , _queuedBytes(0)
+    , _size(-1)
+{
+    // files are written (and removed) one at a time
+    _writer.setMaxThreadCount(1);
+}
+
+
+DiskCache::~DiskCache()
+{
+    _writer.waitForDone();
+}
+
+
+void DiskCache::setBudget(qint64 bytes)
+{
+    const qint64 old = _budget.fetchAndStoreRelaxed( qMax(bytes, qint64(0)) );
+    if (bytes < old) {
+        QtConcurrent::run(&_writer, this, &DiskCache::trim);
+    }
+}
+
+
+QImage DiskCache::read(const QString &name)
+{
+    if (!isEnabled()) {
+        return QImage();
+    }
+
+    TRACE_SCOPE("cache", "disk cache read");
+
+    QFile file(_directory + QLatin1Char('/') + name);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QImage();
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_15);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    qint32 width = 0;
+    qint32 height = 0;
+    qint32 format = 0;
+    qint32 bytesPerLine = 0;
+    QByteArray compressed;
+    in >> magic >> version >> width >> height >> format >> bytesPerLine >> compressed;
+    if (in.status() != QDataStream::Ok || magic != DISKCACHE_MAGIC || version != DISKCACHE_VERSION) {
+        return QImage();
+    }
+
+    // the file was used: it is the last to be removed
+    file.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+
+    const QByteArray pixels = qUncompress(compressed);
+    QImage image(width, height, QImage::Format(format));
+    if (image.isNull() || image.bytesPerLine() != bytesPerLine || image.sizeInBytes() != pixels.size()) {
+        return QImage();
+    }
+    std::memcpy(image.bits(), pixels.constData(), size_t(pixels.size()));
+    return image;
+}
+
+
+void DiskCache::write(const QString &name, const QImage &image)
+{
+    if (!isEnabled() || image.isNull()) {
+        return;
+    }
+
+    // the disk cannot keep up: better to skip a page than to fill the memory
+    const qint64 bytes = image.sizeInBytes();
+    if (_queuedBytes.fetchAndAddRelaxed(bytes) + bytes > MAX_QUEUED_BYTES) {
+        _queuedBytes.fetchAndAddRelaxed(-bytes);
+        return;
+    }
+
+    // the image is implicitly shared: the writer keeps it alive
+    QtConcurrent::run(&_writer, this, &DiskCache::store, name, image);
+}
+
+
+void DiskCache::store(const QString &name, const QImage &image)
+{
+    TRACE_SCOPE("cache", "disk cache write");
+
+    _queuedBytes.fetchAndAddRelaxed(-image.sizeInBytes());
+
+    if (!isEnabled() || !QDir().mkpath(_directory)) {
+        return;
+    }
+    if (_size < 0) {
+        trim();
+    }
+
+    const QString path = _directory + QLatin1Char('/') + name;
+    const qint64 oldSize = QFileInfo(path).size();
+
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    // a fast compression level: pages are big, and rendered again otherwise
+    const QByteArray compressed = qCompress(image.constBits(), int(image.sizeInBytes()), 1);
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_15);
+    out << DISKCACHE_MAGIC << DISKCACHE_VERSION
+        << qint32(image.width()) << qint32(image.height())
+        << qint32(image.format()) << qint32(image.bytesPerLine())
+        << compressed;
+    if (!file.commit()) {
+        return;
+    }
+
+    _size += QFileInfo(path).size() - oldSize;
+    if (_size > budget()) {
+        trim();
+    }
+}
+
+
+void DiskCache::trim()
+{
+    // the least recently used first
+    const QFileInfoList files = QDir(_directory).entryInfoList(QDir::Files, QDir::Time | QDir::Reversed);
+
+    _size = 0;
+    for (const QFileInfo &info : files) {
+        _size += info.size();
+    }
+
+    // some room is made, not to trim again at the next write
+    const qint64 target = budget() / 10 * 9;
+    for (const QFileInfo &info : files) {
+        if (_size <= target) {
+            break;
+        }
+        if (QFile::remove(info.absoluteFilePath())) {
+            _size -= info.size();
+        }
+    }
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef DISKCACHE_H
+#define DISKCACHE_H
+
+
+#include <QAtomicInteger>
+#include <QImage>
+#include <QString>
+#include <QThreadPool>
+
+
+// Rendered images saved on disk, zlib compressed, one file each.
+// Reads happen in the calling thread (a render worker), writes are queued
+// to a single background thread, that also removes the least recently
+// used files when the total size goes over the budget.
+// All the functions are thread safe.
+class DiskCache
+{
+public:
+    explicit DiskCache(const QString &directory);
+
+    // waits for the queued writes
+    ~DiskCache();
+
+    // 0 disables the cache, and removes its files
+    void setBudget(qint64 bytes);
+    inline qint64 budget() const { return _budget.loadRelaxed(); }
+    inline bool isEnabled() const { return budget() > 0; }
+
+    // returns a null image if name is not there
+    QImage read(const QString &name);
+    void write(const QString &name, const QImage &image);
+
+private:
+    // the writer thread work
+    void store(const QString &name, const QImage &image);
+    void trim();
+
+private:
+    const QString _directory;
+    QAtomicInteger<qint64> _budget;
+
+    // images queued for writing, not to pile up when the disk is slow
+    QAtomicInteger<qint64> _queuedBytes;
+
+    // the files total size, used only by the writer thread (-1 until scanned)
+    qint64 _size;
+    QThreadPool _writer;
+};
+
+#endif // DISKCACHE_H
@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "documentloader.h"
+
+#include "mappedfile.h"
+#include "tracing.h"
+
+#include <QtConcurrent>
+
+#include <QCryptographicHash>
+#include <QFile>
+
+
+static QPdfDocument::DocumentError loadDocument(QPdfDocument *document,
+                                                MappedFile *file,
+                                                bool copied,
+                                                const QString &path,
+                                                QSharedPointer<QAtomicInt> cancelled)
+{
+    TRACE_SCOPE("load", "load document");
+
+    // a load queued behind another one may be cancelled before it starts
+    if (cancelled->loadAcquire()) {
+        return QPdfDocument::UnknownError;
+    }
+
+    // files that cannot be mapped (or copied) are read the usual way
+    if (!file || !(copied ? file->copy() : file->map())) {
+        return document->load(path);
+    }
+
+    document->load(file);
+    if (document->status() == QPdfDocument::Ready) {
+        return QPdfDocument::NoError;
+    }
+    const QPdfDocument::DocumentError error = document->error();
+    return error != QPdfDocument::NoError ? error : QPdfDocument::UnknownError;
+}
+
+
+static QByteArray hashFile(const QString &path, QSharedPointer<QAtomicInt> cancelled)
+{
+    TRACE_SCOPE("load", "hash document");
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    QByteArray buffer;
+    while (!file.atEnd()) {
+        if (cancelled->loadAcquire()) {
+            return QByteArray();
+        }
+        buffer = file.read(1024 * 1024);
+        if (buffer.isEmpty()) {
+            return QByteArray();
+        }
+        hash.addData(buffer);
+    }
+    return hash.result();
+}
+
+
+static QString errorString(QPdfDocument::DocumentError error)
+{
+    switch (error) {
+        case QPdfDocument::FileNotFoundError:
+            return DocumentLoader::tr("File not found");
+        case QPdfDocument::InvalidFileFormatError:
+            return DocumentLoader::tr("Invalid file format");
+        case QPdfDocument::IncorrectPasswordError:
+            return DocumentLoader::tr("Incorrect password");
+        case QPdfDocument::UnsupportedSecuritySchemeError:
+            return DocumentLoader::tr("Unsupported security scheme");
+        default:
+            return DocumentLoader::tr("Unknown error");
+    }
+}
+
+
+DocumentLoader::DocumentLoader(QObject *parent)
+    : QObject(parent)
+    , _document(nullptr)
+    , _watcher(nullptr)
+    , _hashWatcher(nullptr)
+    , _memoryMapped(true)
+    , _copiedInMemory(false)
+{
+}
+
+
+DocumentLoader::~DocumentLoader()
+{
+    cancel();
+}
+
+
+bool DocumentLoader::isLoading() const
+{
+    return _watcher != nullptr;
+}
+
+
+bool DocumentLoader::isMemoryMapped(const QPdfDocument *document)
+{
+    // the device the document reads is one of its children
+    const MappedFile* file = document ? document->findChild<MappedFile*>(QString(), Qt::FindDirectChildrenOnly) : nullptr;
+    return file && file->isMapped();
+}
+
+
+void DocumentLoader::load(const QString &path)
+{
+    cancel();
+
+    _filePath = path;
+    _cancelled.reset(new QAtomicInt(0));
+
+    // The document is created here, with GUI thread affinity, but it is
+    // touched only by the worker until the load finishes
+    _document = new QPdfDocument;
+    connect(_document, &QPdfDocument::pageCountChanged, this, &DocumentLoader::pageCountChanged, Qt::QueuedConnection);
+
+    // the mapping (or the copy) has to live as long as the document reading it
+    MappedFile* file = (_memoryMapped || _copiedInMemory) ? new MappedFile(path, _document) : nullptr;
+
+    _watcher = new QFutureWatcher<QPdfDocument::DocumentError>;
+    connect(_watcher, &QFutureWatcherBase::finished, this, &DocumentLoader::onLoadFinished);
+    _watcher->setFuture( QtConcurrent::run(loadDocument, _document, file, _copiedInMemory, path, _cancelled) );
+
+    // the file is read once more for its hash, while the PDF library parses it
+    _hashCancelled = _cancelled;
+    _hashWatcher = new QFutureWatcher<QByteArray>;
+    _hashWatcher->setFuture( QtConcurrent::run(hashFile, path, _hashCancelled) );
+}
+
+
+void DocumentLoader::cancel()
+{
+    cancelHash();
+
+    if (!_watcher) {
+        return;
+    }
+
+    _cancelled->storeRelease(1);
+
+    // the PDF library cannot be interrupted: let the worker end
+    // on its own and throw away what it produces
+    QPdfDocument* document = _document;
+    QFutureWatcher<QPdfDocument::DocumentError>* watcher = _watcher;
+    document->disconnect(this);
+    watcher->disconnect(this);
+    connect(watcher, &QFutureWatcherBase::finished, watcher, [=] () {
+            document->deleteLater();
+            watcher->deleteLater();
+        }
+    );
+
+    _document = nullptr;
+    _watcher = nullptr;
+    _filePath.clear();
+}
+
+
+void DocumentLoader::cancelHash()
+{
+    if (!_hashWatcher) {
+        return;
+    }
+
+    _hashCancelled->storeRelease(1);
+
+    QFutureWatcher<QByteArray>* watcher = _hashWatcher;
+    watcher->disconnect(this);
+    if (watcher->isFinished()) {
+        watcher->deleteLater();
+    } else {
+        connect(watcher, &QFutureWatcherBase::finished, watcher, &QObject::deleteLater);
+    }
+
+    _hashWatcher = nullptr;
+    _hashedDocument = nullptr;
+}
+
+
+void DocumentLoader::onLoadFinished()
+{
+    const QPdfDocument::DocumentError error = _watcher->result();
+
+    QPdfDocument* document = _document;
+    const QString path = _filePath;
+
+    _watcher->deleteLater();
+    _watcher = nullptr;
+    _document = nullptr;
+    _filePath.clear();
+
+    document->disconnect(this);
+
+    if (error != QPdfDocument::NoError) {
+        cancelHash();
+        document->deleteLater();
+        Q_EMIT failed(path, errorString(error));
+        return;
+    }
+
+    const QString title = document->metaData(QPdfDocument::Title).toString();
+    Q_EMIT loaded(document, title);
+
+    // the hash is delivered once both are done (unless the
+    // receiver started a new load in the meantime)
+    if (!_hashWatcher) {
+        return;
+    }
+    _hashedDocument = document;
+    if (_hashWatcher->isFinished()) {
+        onHashFinished();
+    } else {
+        connect(_hashWatcher, &QFutureWatcherBase::finished, this, &DocumentLoader::onHashFinished);
+    }
+}
+
+
+void DocumentLoader::onHashFinished()
+{
+    const QByteArray hash = _hashWatcher->result();
+    QPdfDocument* document = _hashedDocument.data();
+
+    _hashWatcher->deleteLater();
+    _hashWatcher = nullptr;
+    _hashedDocument = nullptr;
+
+    if (document && !hash.isEmpty()) {
+        Q_EMIT contentHashReady(document, hash);
+    }
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef DOCUMENTLOADER_H
+#define DOCUMENTLOADER_H
+
+
+#include <QAtomicInt>
+#include <QFutureWatcher>
+#include <QObject>
+#include <QPdfDocument>
+#include <QPointer>
+#include <QSharedPointer>
+
+
+// Opens a PDF file off the GUI thread.
+// Only one load runs at a time: starting a new one (or calling cancel)
+// drops the previous one, whose document is thrown away when the worker returns.
+class DocumentLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DocumentLoader(QObject *parent = nullptr);
+    ~DocumentLoader();
+
+    void load(const QString &path);
+    void cancel();
+
+    bool isLoading() const;
+    inline QString filePath() const { return _filePath; }
+
+    // read documents through a memory mapping of the file
+    // (the default) instead of letting the PDF library read them
+    inline void setMemoryMapped(bool on) { _memoryMapped = on; }
+
+    // read documents from a copy of the file in memory, mapped or not:
+    // for files that may be rewritten while they are shown
+    inline void setCopiedInMemory(bool on) { _copiedInMemory = on; }
+
+    // true if document, loaded by a loader, reads a mapping of its file
+    static bool isMemoryMapped(const QPdfDocument *document);
+
+Q_SIGNALS:
+    // emitted as soon as the PDF library knows it, before the load completes
+    void pageCountChanged(int pageCount);
+
+    // the receiver takes ownership of document
+    void loaded(QPdfDocument *document, const QString &title);
+    void failed(const QString &path, const QString &error);
+
+    // a hash of the file content, computed in parallel with the load:
+    // always emitted after loaded(document), and never if a new load starts
+    // or document was deleted meanwhile (a duplicate of a document open)
+    void contentHashReady(QPdfDocument *document, const QByteArray &hash);
+
+private Q_SLOTS:
+    void onLoadFinished();
+    void onHashFinished();
+
+private:
+    void cancelHash();
+
+private:
+    QPdfDocument* _document;
+    QFutureWatcher<QPdfDocument::DocumentError>* _watcher;
+    QSharedPointer<QAtomicInt> _cancelled;
+
+    // the loaded document waiting for its hash: the receiver of
+    // loaded() may delete it
+    QPointer<QPdfDocument> _hashedDocument;
+    QFutureWatcher<QByteArray>* _hashWatcher;
+    QSharedPointer<QAtomicInt> _hashCancelled;
+
+    QString _filePath;
+    bool _memoryMapped;
+    bool _copiedInMemory;
+};
+
+#endif // DOCUMENTLOADER_H
@@ -0,0 +1,253 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "documentregistry.h"
+
+#include "rendercache.h"
+
+#include <QtConcurrent>
+
+#include <QFile>
+#include <QFileInfo>
+#include <QPdfDocument>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+
+DocumentRegistry::DocumentRegistry(RenderCache *cache, QObject *parent)
+    : QObject(parent)
+    , _cache(cache)
+{
+    _pool.setMaxThreadCount(1);
+}
+
+
+DocumentRegistry::~DocumentRegistry()
+{
+    for (auto it = _entries.begin(); it != _entries.end(); ++it) {
+        stopFingerprints(it.value());
+    }
+}
+
+
+QString DocumentRegistry::fileKey(const QString &path)
+{
+#ifdef Q_OS_UNIX
+    struct stat st;
+    if (::stat(QFile::encodeName(path).constData(), &st) == 0) {
+        return QString::number(quint64(st.st_dev)) + QLatin1Char(':') + QString::number(quint64(st.st_ino));
+    }
+#endif
+    return QFileInfo(path).canonicalFilePath();
+}
+
+
+QPdfDocument* DocumentRegistry::acquire(const QString &path)
+{
+    const QString key = fileKey(path);
+    if (key.isEmpty()) {
+        return nullptr;
+    }
+
+    QPdfDocument* document = _documents.value(key);
+    if (document) {
+        ++_entries[document].refs;
+    }
+    return document;
+}
+
+
+QPdfDocument* DocumentRegistry::add(const QString &path, QPdfDocument *document, const QString &title)
+{
+    const QString key = fileKey(path);
+
+    // two windows loaded the same file at once: the first one wins
+    QPdfDocument* existing = _documents.value(key);
+    if (existing && !key.isEmpty()) {
+        ++_entries[existing].refs;
+        destroy(document);
+        return existing;
+    }
+
+    Entry entry;
+    entry.path = path;
+    entry.key = key;
+    entry.title = title;
+    entry.refs = 1;
+    _entries.insert(document, entry);
+    if (!key.isEmpty()) {
+        _documents.insert(key, document);
+    }
+
+    document->setParent(this);
+    return document;
+}
+
+
+void DocumentRegistry::replace(QPdfDocument *from, QPdfDocument *to, const QString &path, const QString &title)
+{
+    const auto it = _entries.constFind(from);
+    if (it == _entries.constEnd()) {
+        add(path, to, title);
+        return;
+    }
+
+    // a file replaced by a rename has a new inode
+    Entry entry;
+    entry.path = path;
+    entry.key = fileKey(path);
+    entry.title = title;
+    entry.refs = it.value().refs;
+
+    if (_documents.value(it.value().key) == from) {
+        _documents.remove(it.value().key);
+    }
+    _entries.insert(to, entry);
+    if (!entry.key.isEmpty()) {
+        _documents.insert(entry.key, to);
+    }
+    to->setParent(this);
+
+    Q_EMIT replaced(from, to);
+}
+
+
+void DocumentRegistry::release(QPdfDocument *document)
+{
+    if (!document) {
+        return;
+    }
+
+    auto it = _entries.find(document);
+    if (it == _entries.end()) {
+        destroy(document);
+        return;
+    }
+
+    if (--it.value().refs > 0) {
+        return;
+    }
+
+    if (_documents.value(it.value().key) == document) {
+        _documents.remove(it.value().key);
+    }
+    stopFingerprints(it.value());
+    _entries.erase(it);
+    destroy(document);
+}
+
+
+QString DocumentRegistry::title(const QPdfDocument *document) const
+{
+    return _entries.value(document).title;
+}
+
+
+QByteArray DocumentRegistry::contentHash(const QPdfDocument *document) const
+{
+    return _entries.value(document).contentHash;
+}
+
+
+void DocumentRegistry::setContentHash(QPdfDocument *document, const QByteArray &hash)
+{
+    auto it = _entries.find(document);
+    if (it == _entries.end() || it.value().contentHash == hash) {
+        return;
+    }
+
+    it.value().contentHash = hash;
+    _cache->setContentHash(document, hash);
+
+    Q_EMIT contentHashReady(document, hash);
+}
+
+
+void DocumentRegistry::takeFingerprints(QPdfDocument *document)
+{
+    auto it = _entries.find(document);
+    if (it == _entries.end() || it.value().fingerprinted || it.value().fingerprintWatcher) {
+        return;
+    }
+
+    const QSharedPointer<QAtomicInt> cancelled(new QAtomicInt(0));
+    auto watcher = new QFutureWatcher<PageFingerprints>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [=] () {
+            auto entry = _entries.find(document);
+            if (entry == _entries.end() || entry.value().fingerprintWatcher != watcher) {
+                return;
+            }
+            entry.value().fingerprintWatcher = nullptr;
+            entry.value().fingerprintCancelled.reset();
+            const PageFingerprints fingerprints = watcher->result();
+            watcher->deleteLater();
+            setFingerprints(document, fingerprints);
+        }
+    );
+
+    it.value().fingerprintWatcher = watcher;
+    it.value().fingerprintCancelled = cancelled;
+    watcher->setFuture( QtConcurrent::run(&_pool, [=] () {
+            return PageMatcher::fingerprints(document, cancelled.data());
+        }
+    ) );
+}
+
+
+bool DocumentRegistry::hasFingerprints(const QPdfDocument *document) const
+{
+    const auto it = _entries.constFind(document);
+    return it == _entries.constEnd() || it.value().fingerprinted;
+}
+
+
+PageFingerprints DocumentRegistry::fingerprints(const QPdfDocument *document) const
+{
+    return _entries.value(document).fingerprints;
+}
+
+
+void DocumentRegistry::setFingerprints(QPdfDocument *document, const PageFingerprints &fingerprints)
+{
+    auto it = _entries.find(document);
+    if (it == _entries.end()) {
+        return;
+    }
+
+    stopFingerprints(it.value());
+    it.value().fingerprints = fingerprints;
+    it.value().fingerprinted = true;
+
+    Q_EMIT fingerprintsReady(document);
+}
+
+
+void DocumentRegistry::stopFingerprints(Entry &entry)
+{
+    if (!entry.fingerprintWatcher) {
+        return;
+    }
+
+    // the worker stops at the next page
+    entry.fingerprintCancelled->storeRelease(1);
+    entry.fingerprintWatcher->disconnect(this);
+    entry.fingerprintWatcher->waitForFinished();
+    delete entry.fingerprintWatcher;
+    entry.fingerprintWatcher = nullptr;
+    entry.fingerprintCancelled.reset();
+}
+
+
+void DocumentRegistry::destroy(QPdfDocument *document)
+{
+    _cache->removeDocument(document);
+    document->deleteLater();
+}
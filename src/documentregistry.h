@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef DOCUMENTREGISTRY_H
+#define DOCUMENTREGISTRY_H
+
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+#include <QThreadPool>
+
+#include "pagematcher.h"
+
+class QPdfDocument;
+
+class RenderCache;
+
+
+// The documents open in any window, shared by all the windows showing
+// the same file: it is parsed once, and its pages rendered once.
+// Files are told apart by device and inode (by canonical path where
+// there are none), so that links to a file share its document too.
+// Windows hold a reference to the document they show: it is deleted,
+// and dropped from the render cache, with the last one.
+// The page fingerprints a reload compares with are kept here too, taken
+// once for each document whatever the windows showing it.
+class DocumentRegistry : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DocumentRegistry(RenderCache *cache, QObject *parent = nullptr);
+
+    // waits for the fingerprints being taken
+    ~DocumentRegistry();
+
+    // the document open for path, with a new reference to it (nullptr if none)
+    QPdfDocument* acquire(const QString &path);
+
+    // registers document, just loaded from path, with a reference to it.
+    // Returns the document to use: the one already there, if the same
+    // file was opened in the meantime (and document is deleted)
+    QPdfDocument* add(const QString &path, QPdfDocument *document, const QString &title);
+
+    // to is a new version of from: every window holding from is asked
+    // to switch to to, holding its reference to to, and to release from
+    void replace(QPdfDocument *from, QPdfDocument *to, const QString &path, const QString &title);
+
+    // drops a reference: documents never registered are deleted at once
+    void release(QPdfDocument *document);
+
+    QString title(const QPdfDocument *document) const;
+
+    QByteArray contentHash(const QPdfDocument *document) const;
+    void setContentHash(QPdfDocument *document, const QByteArray &hash);
+
+    // the page fingerprints of document (see PageMatcher), taken in
+    // background by the first call to takeFingerprints() only
+    void takeFingerprints(QPdfDocument *document);
+    // true for documents never registered: there is nothing to wait for
+    bool hasFingerprints(const QPdfDocument *document) const;
+    PageFingerprints fingerprints(const QPdfDocument *document) const;
+    void setFingerprints(QPdfDocument *document, const PageFingerprints &fingerprints);
+
+Q_SIGNALS:
+    void replaced(QPdfDocument *from, QPdfDocument *to);
+    void contentHashReady(QPdfDocument *document, const QByteArray &hash);
+    void fingerprintsReady(QPdfDocument *document);
+
+private:
+    // what tells files apart
+    static QString fileKey(const QString &path);
+
+    void destroy(QPdfDocument *document);
+
+private:
+    struct Entry
+    {
+        QString path;
+        QString key;
+        QString title;
+        QByteArray contentHash;
+        int refs = 0;
+
+        PageFingerprints fingerprints;
+        bool fingerprinted = false;
+        QFutureWatcher<PageFingerprints>* fingerprintWatcher = nullptr;
+        QSharedPointer<QAtomicInt> fingerprintCancelled;
+    };
+
+    // waits for the fingerprints of entry being taken, if any
+    void stopFingerprints(Entry &entry);
+
+private:
+    RenderCache* _cache;
+
+    // the PDF library works one call at a time anyway
+    QThreadPool _pool;
+
+    // every document referenced, and the current one of each file:
+    // the versions replaced stay until released by all the windows
+    QHash<const QPdfDocument*, Entry> _entries;
+    QHash<QString, QPdfDocument*> _documents;
+};
+
+#endif // DOCUMENTREGISTRY_H
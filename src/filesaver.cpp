@@ -0,0 +1,304 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "filesaver.h"
+
+#include "rendercache.h"
+#include "tracing.h"
+
+#include <QtConcurrent>
+
+#include <QFile>
+#include <QPainter>
+#include <QPdfDocument>
+#include <QPdfWriter>
+#include <QSaveFile>
+
+#ifdef Q_OS_LINUX
+#include <errno.h>
+#include <sys/sendfile.h>
+#include <unistd.h>
+#endif
+
+
+// bytes copied between two progress reports
+static const qint64 COPY_CHUNK = 16 * 1024 * 1024;
+
+
+static void reportProgress(FileSaver *saver, qint64 done, qint64 total)
+{
+    QMetaObject::invokeMethod(saver, [=] () {
+            Q_EMIT saver->progress(done, total);
+        }, Qt::QueuedConnection
+    );
+}
+
+
+#ifdef Q_OS_LINUX
+// copies up to count bytes between the file offsets of in and out, inside
+// the kernel. Returns the bytes copied, or -1 if the kernel cannot do it
+static qint64 kernelCopy(int in, int out, qint64 count)
+{
+    // copy_file_range even lets file systems share the data (or the
+    // server do the copy), but it does not work across file systems
+    // on older kernels: then sendfile can still do it
+    static QAtomicInt useSendfile(0);
+
+    ssize_t copied = -1;
+    if (!useSendfile.loadRelaxed()) {
+        copied = copy_file_range(in, nullptr, out, nullptr, size_t(count), 0);
+        if (copied >= 0) {
+            return copied;
+        }
+        if (errno != ENOSYS && errno != EXDEV && errno != EINVAL && errno != EOPNOTSUPP) {
+            return -1;
+        }
+        useSendfile.storeRelaxed(1);
+    }
+
+    copied = sendfile(out, in, nullptr, size_t(count));
+    return copied;
+}
+#endif
+
+
+static QString copyFile(const QString &source, const QString &destination,
+                        FileSaver *saver, QSharedPointer<QAtomicInt> cancelled)
+{
+    TRACE_SCOPE("save", "copy file");
+
+    QFile in(source);
+    if (!in.open(QIODevice::ReadOnly)) {
+        return FileSaver::tr("Cannot read %1: %2").arg(source, in.errorString());
+    }
+
+    // the destination is replaced only by a complete copy
+    QSaveFile out(destination);
+    if (!out.open(QIODevice::WriteOnly)) {
+        return FileSaver::tr("Cannot write %1: %2").arg(destination, out.errorString());
+    }
+
+    const qint64 total = in.size();
+    qint64 done = 0;
+
+#ifdef Q_OS_LINUX
+    while (done < total && !cancelled->loadAcquire()) {
+        const qint64 copied = kernelCopy(in.handle(), out.handle(), qMin(total - done, COPY_CHUNK));
+        if (copied <= 0) {
+            break;
+        }
+        done += copied;
+        reportProgress(saver, done, total);
+    }
+
+    // the rest (all of it, if the kernel could not help) the usual way
+    in.seek(done);
+    out.seek(done);
+#endif
+
+    QByteArray buffer;
+    while (done < total && !cancelled->loadAcquire()) {
+        buffer = in.read( qMin(total - done, qint64(1024 * 1024)) );
+        if (buffer.isEmpty() || out.write(buffer) != buffer.size()) {
+            out.cancelWriting();
+            return FileSaver::tr("Cannot copy %1 to %2").arg(source, destination);
+        }
+        done += buffer.size();
+        if (done % COPY_CHUNK < buffer.size() || done == total) {
+            reportProgress(saver, done, total);
+        }
+    }
+
+    if (cancelled->loadAcquire()) {
+        out.cancelWriting();
+        return FileSaver::tr("Cancelled");
+    }
+
+    if (!out.commit()) {
+        return FileSaver::tr("Cannot write %1: %2").arg(destination, out.errorString());
+    }
+    return QString();
+}
+
+
+static QString writePages(QPdfDocument *document, int first, int last, const QString &destination,
+                          FileSaver *saver, QSharedPointer<QAtomicInt> cancelled)
+{
+    TRACE_SCOPE("save", "save pages");
+
+    QSaveFile file(destination);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return FileSaver::tr("Cannot write %1: %2").arg(destination, file.errorString());
+    }
+
+    // each page is written to the file as soon as the next one starts
+    QPdfWriter writer(&file);
+    writer.setResolution(FileSaver::PAGE_DPI);
+    writer.setCreator( QStringLiteral("cuteviewer") );
+    writer.setTitle( document->metaData(QPdfDocument::Title).toString() );
+
+    QPainter painter;
+    for (int page = first; page <= last; ++page) {
+        if (cancelled->loadAcquire()) {
+            painter.end();
+            file.cancelWriting();
+            return FileSaver::tr("Cancelled");
+        }
+
+        // every page keeps its own size
+        const QSizeF pageSize = document->pageSize(page);
+        writer.setPageLayout( QPageLayout(QPageSize(pageSize, QPageSize::Point), QPageLayout::Portrait, QMarginsF()) );
+        if (page == first) {
+            if (!painter.begin(&writer)) {
+                file.cancelWriting();
+                return FileSaver::tr("Cannot write %1").arg(destination);
+            }
+        } else {
+            writer.newPage();
+        }
+
+        const QImage image = RenderCache::renderPage(document, page, (pageSize * FileSaver::PAGE_DPI / 72.0).toSize());
+        if (!image.isNull()) {
+            painter.drawImage(QRect(0, 0, writer.width(), writer.height()), image);
+        }
+
+        reportProgress(saver, page - first + 1, last - first + 1);
+    }
+    painter.end();
+
+    if (!file.commit()) {
+        return FileSaver::tr("Cannot write %1: %2").arg(destination, file.errorString());
+    }
+    return QString();
+}
+
+
+static void dropFinished(QList<QFuture<QString> > *futures)
+{
+    for (int i = futures->count() - 1; i >= 0; --i) {
+        if (futures->at(i).isFinished()) {
+            futures->removeAt(i);
+        }
+    }
+}
+
+
+FileSaver::FileSaver(QObject *parent)
+    : QObject(parent)
+    , _watcher(nullptr)
+    , _savingPages(false)
+{
+}
+
+
+FileSaver::~FileSaver()
+{
+    // workers report to this object
+    stop();
+}
+
+
+void FileSaver::copyFile(const QString &source, const QString &destination)
+{
+    cancel();
+    _cancelled.reset(new QAtomicInt(0));
+
+    _savingPages = false;
+
+    FileSaver* saver = this;
+    QSharedPointer<QAtomicInt> cancelled = _cancelled;
+    start( QtConcurrent::run([=] () {
+            return ::copyFile(source, destination, saver, cancelled);
+        })
+    );
+}
+
+
+void FileSaver::savePages(QPdfDocument *document, int first, int last, const QString &destination)
+{
+    cancel();
+    _cancelled.reset(new QAtomicInt(0));
+
+    _savingPages = true;
+
+    FileSaver* saver = this;
+    QSharedPointer<QAtomicInt> cancelled = _cancelled;
+    start( QtConcurrent::run([=] () {
+            return writePages(document, first, last, destination, saver, cancelled);
+        })
+    );
+}
+
+
+void FileSaver::cancel()
+{
+    if (!_watcher) {
+        return;
+    }
+
+    _cancelled->storeRelease(1);
+
+    // the worker stops at the next chunk, or page: its watcher goes with it
+    _watcher->disconnect(this);
+    connect(_watcher, &QFutureWatcherBase::finished, _watcher, &QObject::deleteLater);
+
+    dropFinished(&_cancelledSaves);
+    dropFinished(&_cancelledPageSaves);
+    _cancelledSaves.append( _watcher->future() );
+    if (_savingPages) {
+        _cancelledPageSaves.append( _watcher->future() );
+    }
+    _watcher = nullptr;
+
+    Q_EMIT finished(false, tr("Cancelled"));
+}
+
+
+void FileSaver::stop()
+{
+    cancel();
+
+    for (QFuture<QString> &future : _cancelledSaves) {
+        future.waitForFinished();
+    }
+    _cancelledSaves.clear();
+    _cancelledPageSaves.clear();
+}
+
+
+void FileSaver::stopPageSave()
+{
+    if (_savingPages) {
+        cancel();
+    }
+
+    for (QFuture<QString> &future : _cancelledPageSaves) {
+        future.waitForFinished();
+    }
+    _cancelledPageSaves.clear();
+}
+
+
+void FileSaver::start(const QFuture<QString> &future)
+{
+    _watcher = new QFutureWatcher<QString>;
+    connect(_watcher, &QFutureWatcherBase::finished, this, &FileSaver::onSaveFinished);
+    _watcher->setFuture(future);
+}
+
+
+void FileSaver::onSaveFinished()
+{
+    const QString error = _watcher->result();
+
+    _watcher->deleteLater();
+    _watcher = nullptr;
+
+    Q_EMIT finished(error.isEmpty(), error);
+}
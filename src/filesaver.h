@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef FILESAVER_H
+#define FILESAVER_H
+
+
+#include <QAtomicInt>
+#include <QFutureWatcher>
+#include <QList>
+#include <QObject>
+#include <QSharedPointer>
+
+class QPdfDocument;
+
+
+// Saves documents off the GUI thread, one save at a time.
+// A whole document is copied by the kernel (copy_file_range or sendfile,
+// where available), without passing through the process memory.
+// A range of pages is exported as a new PDF of page images, as the PDF
+// library cannot write documents: pages are rendered and written one by one,
+// and their text and vector graphics are lost.
+// A cancelled save ends on its own: only stop() and stopPageSave() wait for it.
+class FileSaver : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FileSaver(QObject *parent = nullptr);
+
+    // stops the save, if still running
+    ~FileSaver();
+
+    void copyFile(const QString &source, const QString &destination);
+
+    // pages are 0-based, last included
+    void savePages(QPdfDocument *document, int first, int last, const QString &destination);
+
+    inline bool isSaving() const { return _watcher != nullptr; }
+
+    // returns at once: the worker stops at the next chunk, or page
+    void cancel();
+
+    // cancels, and waits for the workers still running
+    void stop();
+
+    // cancels a page save, and waits for the page saves still running:
+    // after it their document can be deleted. File copies go on
+    void stopPageSave();
+
+    // the resolution of the saved page images
+    static const int PAGE_DPI = 300;
+
+Q_SIGNALS:
+    // done and total are bytes for a copy, pages for a page range
+    void progress(qint64 done, qint64 total);
+    void finished(bool ok, const QString &error);
+
+private Q_SLOTS:
+    void onSaveFinished();
+
+private:
+    void start(const QFuture<QString> &future);
+
+private:
+    QFutureWatcher<QString>* _watcher;
+    QSharedPointer<QAtomicInt> _cancelled;
+
+    bool _savingPages;
+
+    // the saves cancelled, maybe still running, and the page saves among them
+    QList<QFuture<QString> > _cancelledSaves;
+    QList<QFuture<QString> > _cancelledPageSaves;
+};
+
+#endif // FILESAVER_H
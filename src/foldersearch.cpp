@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "foldersearch.h"
+
+#include "textscan.h"
+#include "tracing.h"
+
+#include <QtConcurrent>
+
+#include <QDir>
+#include <QDirIterator>
+
+
+// the text shown around a match
+static const int SNIPPET_BEFORE = 40;
+static const int SNIPPET_AFTER = 60;
+
+// files listed between two counts reported
+static const int LIST_BATCH = 256;
+
+
+const int FolderSearch::MAX_FILE_HITS;
+const int FolderSearch::MAX_HITS;
+
+
+static QString snippet(const QString &text, int offset)
+{
+    const int start = qMax(0, offset - SNIPPET_BEFORE);
+    QString line = text.mid(start, offset - start + SNIPPET_AFTER).simplified();
+    if (start > 0) {
+        line.prepend( QChar(0x2026) );
+    }
+    if (offset + SNIPPET_AFTER < text.size()) {
+        line.append( QChar(0x2026) );
+    }
+    return line;
+}
+
+
+static QVector<FolderSearchHit> searchFile(const TextIndex &index, const QString &path,
+                                           const SearchPattern &pattern, const QAtomicInt *cancelled,
+                                           TextIndex::Status *status)
+{
+    TRACE_SCOPE("foldersearch", "search file");
+
+    QVector<FolderSearchHit> hits;
+    QStringList pages;
+    *status = index.pageTexts(path, &pages, cancelled);
+
+    for (int page = 0; page < pages.count() && hits.count() < FolderSearch::MAX_FILE_HITS; ++page) {
+        if (cancelled->loadAcquire()) {
+            break;
+        }
+        const QString &text = pages.at(page);
+        const QString folded = pattern.usesFoldedText() ? TextScan::fold(text, true, true) : QString();
+        const QVector<int> offsets = pattern.matches(text, folded);
+        for (int i = 0; i < offsets.count() && hits.count() < FolderSearch::MAX_FILE_HITS; ++i) {
+            FolderSearchHit hit;
+            hit.page = page;
+            hit.snippet = snippet(text, offsets.at(i));
+            hits.append(hit);
+        }
+    }
+    return hits;
+}
+
+
+FolderSearch::FolderSearch(QObject *parent)
+    : QObject(parent)
+    , _listedFiles(0)
+    , _listingDone(false)
+    , _searchedFiles(0)
+    , _extractedFiles(0)
+    , _hitCount(0)
+{
+    _pool.setMaxThreadCount( QThread::idealThreadCount() );
+    _listingPool.setMaxThreadCount(1);
+}
+
+
+FolderSearch::~FolderSearch()
+{
+    cancel();
+
+    // the jobs report to this object
+    _listing.waitForFinished();
+    _pool.waitForDone();
+}
+
+
+void FolderSearch::start(const QString &directory, const QString &text, SearchEngine::SearchFlags flags)
+{
+    cancel();
+
+    if (text.isEmpty()) {
+        return;
+    }
+    const SearchPattern check(text, flags);
+    if (!check.isValid()) {
+        Q_EMIT failed( tr("Invalid regular expression: %1").arg(check.errorString()) );
+        return;
+    }
+
+    _listedFiles = 0;
+    _listingDone = false;
+    _searchedFiles = 0;
+    _extractedFiles = 0;
+    _hitCount = 0;
+    _cancelled.reset(new QAtomicInt(0));
+
+    // the jobs get everything by value: the results of a search
+    // cancelled meanwhile are dropped
+    const QSharedPointer<QAtomicInt> cancelled = _cancelled;
+    const TextIndex index = _index;
+    QThreadPool* pool = &_pool;
+    FolderSearch* search = this;
+
+    _listing = QtConcurrent::run(&_listingPool, [=] () {
+            TRACE_SCOPE("foldersearch", "list folder");
+
+            // name filters ignore case: *.PDF files are found too
+            QDirIterator it(directory, QStringList() << QStringLiteral("*.pdf"),
+                            QDir::Files | QDir::Readable, QDirIterator::Subdirectories);
+            int count = 0;
+            while (it.hasNext() && !cancelled->loadAcquire()) {
+                const QString path = it.next();
+                ++count;
+
+                QtConcurrent::run(pool, [=] () {
+                        if (cancelled->loadAcquire()) {
+                            return;
+                        }
+                        const SearchPattern pattern(text, flags);
+                        TextIndex::Status status = TextIndex::Failed;
+                        const QVector<FolderSearchHit> hits = searchFile(index, path, pattern, cancelled.data(), &status);
+                        QMetaObject::invokeMethod(search, [=] () {
+                                if (!cancelled->loadAcquire()) {
+                                    search->onFileSearched(path, hits, status);
+                                }
+                            }, Qt::QueuedConnection
+                        );
+                    }
+                );
+
+                if (count % LIST_BATCH == 0) {
+                    QMetaObject::invokeMethod(search, [=] () {
+                            if (!cancelled->loadAcquire()) {
+                                search->onFilesListed(count, false);
+                            }
+                        }, Qt::QueuedConnection
+                    );
+                }
+            }
+
+            QMetaObject::invokeMethod(search, [=] () {
+                    if (!cancelled->loadAcquire()) {
+                        search->onFilesListed(count, true);
+                    }
+                }, Qt::QueuedConnection
+            );
+
+            // the entries of the files gone, now and then
+            index.prune(cancelled.data());
+        }
+    );
+}
+
+
+void FolderSearch::cancel()
+{
+    if (!_cancelled) {
+        return;
+    }
+
+    // the running jobs stop at the next page, the queued ones never start
+    _cancelled->storeRelease(1);
+    _cancelled.reset();
+    _pool.clear();
+}
+
+
+void FolderSearch::onFilesListed(int count, bool done)
+{
+    _listedFiles = count;
+    _listingDone = done;
+
+    // files listed are searched as they are: a few may be ahead of the count
+    Q_EMIT progress(_searchedFiles, qMax(_searchedFiles, _listedFiles));
+    if (_listingDone && _searchedFiles == _listedFiles) {
+        finish(true);
+    }
+}
+
+
+void FolderSearch::onFileSearched(const QString &path, const QVector<FolderSearchHit> &hits, TextIndex::Status status)
+{
+    ++_searchedFiles;
+    if (status == TextIndex::Extracted) {
+        ++_extractedFiles;
+    }
+
+    if (!hits.isEmpty()) {
+        const int kept = qMin(hits.count(), MAX_HITS - _hitCount);
+        _hitCount += kept;
+        Q_EMIT hitsFound(path, hits.mid(0, kept));
+
+        if (_hitCount >= MAX_HITS) {
+            finish(false);
+            return;
+        }
+    }
+
+    Q_EMIT progress(_searchedFiles, qMax(_searchedFiles, _listedFiles));
+    if (_listingDone && _searchedFiles == _listedFiles) {
+        finish(true);
+    }
+}
+
+
+void FolderSearch::finish(bool complete)
+{
+    cancel();
+    Q_EMIT finished(complete);
+}
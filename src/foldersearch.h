@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef FOLDERSEARCH_H
+#define FOLDERSEARCH_H
+
+
+#include <QAtomicInt>
+#include <QFuture>
+#include <QObject>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVector>
+
+#include "searchengine.h"
+#include "textindex.h"
+
+
+// A match found in a file of the folder
+struct FolderSearchHit
+{
+    int page = -1;
+    // the text around the match, on a single line
+    QString snippet;
+};
+
+
+// Looks for a text in every PDF file under a folder.
+// The folder is listed (and the text index pruned) by a thread of its own,
+// out of the global pool, and each file is searched by a job
+// of a bounded pool: its text comes from the text index, and is extracted
+// (and indexed) only when the file changed. The hits of each file are
+// reported as soon as it is searched, files in no particular order.
+class FolderSearch : public QObject
+{
+    Q_OBJECT
+
+public:
+    // hits kept, for each file and in all
+    static const int MAX_FILE_HITS = 50;
+    static const int MAX_HITS = 5000;
+
+    explicit FolderSearch(QObject *parent = nullptr);
+
+    // waits for the jobs running
+    ~FolderSearch();
+
+    // the search going on, if any, is cancelled first
+    void start(const QString &directory, const QString &text, SearchEngine::SearchFlags flags);
+    void cancel();
+
+    inline bool isRunning() const { return !_cancelled.isNull(); }
+
+    // of the last search: the files searched, and those read again (not from the text index)
+    inline int searchedFiles() const { return _searchedFiles; }
+    inline int extractedFiles() const { return _extractedFiles; }
+
+Q_SIGNALS:
+    void hitsFound(const QString &path, const QVector<FolderSearchHit> &hits);
+    void progress(int searchedFiles, int listedFiles);
+    // complete is false if the search stopped at MAX_HITS
+    void finished(bool complete);
+    void failed(const QString &error);
+
+private:
+    void onFilesListed(int count, bool done);
+    void onFileSearched(const QString &path, const QVector<FolderSearchHit> &hits, TextIndex::Status status);
+    void finish(bool complete);
+
+private:
+    TextIndex _index;
+
+    // the files are searched a few at a time
+    QThreadPool _pool;
+    // one listing at a time
+    QThreadPool _listingPool;
+    QFuture<void> _listing;
+    QSharedPointer<QAtomicInt> _cancelled;
+
+    int _listedFiles;
+    bool _listingDone;
+    int _searchedFiles;
+    int _extractedFiles;
+    int _hitCount;
+};
+
+#endif // FOLDERSEARCH_H
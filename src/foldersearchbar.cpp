@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "foldersearchbar.h"
+
+#include "application.h"
+#include "settingsstore.h"
+
+#include <QCheckBox>
+#include <QFileDialog>
+#include <QFileInfo>
+#include <QGridLayout>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QToolButton>
+#include <QTreeWidget>
+#include <QVBoxLayout>
+
+
+// where the file path and the page of a hit are kept
+static const int PATH_ROLE = Qt::UserRole;
+static const int PAGE_ROLE = Qt::UserRole + 1;
+
+
+FolderSearchBar::FolderSearchBar(QWidget *parent)
+    : QDockWidget(tr("Search in Folder"), parent)
+    , _search(new FolderSearch(this))
+    , _queryLineEdit(new QLineEdit(this))
+    , _directoryLineEdit(new QLineEdit(this))
+    , _caseCheckBox( new QCheckBox( tr("Match Case"), this) )
+    , _wordsCheckBox( new QCheckBox( tr("Whole Words"), this) )
+    , _diacriticsCheckBox( new QCheckBox( tr("Ignore Accents"), this) )
+    , _regexCheckBox( new QCheckBox( tr("Regular Expression"), this) )
+    , _searchButton( new QPushButton( tr("Search"), this) )
+    , _results(new QTreeWidget(this))
+    , _statusLabel(new QLabel(this))
+    , _hitCount(0)
+{
+    setObjectName( QStringLiteral("FolderSearch") );
+
+    _queryLineEdit->setPlaceholderText( tr("Search for") );
+    connect(_queryLineEdit, &QLineEdit::returnPressed, this, &FolderSearchBar::startOrStop);
+    connect(_searchButton, &QPushButton::clicked, this, &FolderSearchBar::startOrStop);
+
+    auto browseButton = new QToolButton(this);
+    browseButton->setText( tr("...") );
+    browseButton->setToolTip( tr("Choose the folder") );
+    connect(browseButton, &QToolButton::clicked, this, &FolderSearchBar::chooseDirectory);
+
+    // the last folder searched
+    const QString directory = Application::instance()->settings()->value( QStringLiteral("FolderSearchDirectory") ).toString();
+    _directoryLineEdit->setText(directory);
+
+    _results->setColumnCount(2);
+    _results->setHeaderLabels( QStringList() << tr("Page") << tr("Text") );
+    _results->header()->setSectionResizeMode(0, QHeaderView::ResizeToContents);
+    _results->setUniformRowHeights(true);
+    _results->setRootIsDecorated(true);
+    connect(_results, &QTreeWidget::itemClicked, this, &FolderSearchBar::onItemClicked);
+
+    connect(_search, &FolderSearch::hitsFound, this, &FolderSearchBar::onHitsFound);
+    connect(_search, &FolderSearch::progress, this, &FolderSearchBar::onProgress);
+    connect(_search, &FolderSearch::finished, this, &FolderSearchBar::onFinished);
+    connect(_search, &FolderSearch::failed, this, [=] (const QString &error) {
+            _statusLabel->setText(error);
+        }
+    );
+
+    // The UI
+    auto queryLayout = new QHBoxLayout;
+    queryLayout->addWidget(_queryLineEdit);
+    queryLayout->addWidget(_searchButton);
+
+    auto directoryLayout = new QHBoxLayout;
+    directoryLayout->addWidget(_directoryLineEdit);
+    directoryLayout->addWidget(browseButton);
+
+    auto optionsLayout = new QGridLayout;
+    optionsLayout->addWidget(_caseCheckBox, 0, 0);
+    optionsLayout->addWidget(_wordsCheckBox, 0, 1);
+    optionsLayout->addWidget(_diacriticsCheckBox, 1, 0);
+    optionsLayout->addWidget(_regexCheckBox, 1, 1);
+
+    auto layout = new QVBoxLayout;
+    layout->addLayout(queryLayout);
+    layout->addLayout(directoryLayout);
+    layout->addLayout(optionsLayout);
+    layout->addWidget(_results);
+    layout->addWidget(_statusLabel);
+
+    QWidget* w = new QWidget(this);
+    w->setLayout(layout);
+    setWidget(w);
+
+    setFocusProxy(_queryLineEdit);
+}
+
+
+void FolderSearchBar::setDirectory(const QString &directory)
+{
+    if (_directoryLineEdit->text().isEmpty()) {
+        _directoryLineEdit->setText(directory);
+    }
+}
+
+
+void FolderSearchBar::chooseDirectory()
+{
+    const QString directory = QFileDialog::getExistingDirectory(this, tr("Search in Folder"), _directoryLineEdit->text());
+    if (!directory.isEmpty()) {
+        _directoryLineEdit->setText(directory);
+    }
+}
+
+
+void FolderSearchBar::startOrStop()
+{
+    if (_search->isRunning()) {
+        _search->cancel();
+        _searchButton->setText( tr("Search") );
+        _statusLabel->setText( tr("Stopped") );
+        return;
+    }
+
+    const QString directory = _directoryLineEdit->text();
+    if (_queryLineEdit->text().isEmpty() || !QFileInfo(directory).isDir()) {
+        _statusLabel->setText( tr("Choose a folder and the text to search") );
+        return;
+    }
+    Application::instance()->settings()->setValue( QStringLiteral("FolderSearchDirectory"), directory );
+
+    SearchEngine::SearchFlags flags;
+    flags.setFlag(SearchEngine::CaseSensitive, _caseCheckBox->isChecked());
+    flags.setFlag(SearchEngine::WholeWords, _wordsCheckBox->isChecked());
+    flags.setFlag(SearchEngine::IgnoreDiacritics, _diacriticsCheckBox->isChecked());
+    flags.setFlag(SearchEngine::RegularExpression, _regexCheckBox->isChecked());
+
+    _results->clear();
+    _hitCount = 0;
+    _statusLabel->setText( tr("Searching...") );
+
+    _search->start(directory, _queryLineEdit->text(), flags);
+    if (_search->isRunning()) {
+        _searchButton->setText( tr("Stop") );
+    }
+}
+
+
+void FolderSearchBar::onHitsFound(const QString &path, const QVector<FolderSearchHit> &hits)
+{
+    // a file, and its hits below it
+    const QFileInfo info(path);
+    auto fileItem = new QTreeWidgetItem(_results);
+    fileItem->setText(0, tr("%1 (%2)").arg(info.fileName()).arg(hits.count()));
+    fileItem->setToolTip(0, path);
+    fileItem->setData(0, PATH_ROLE, path);
+    fileItem->setData(0, PAGE_ROLE, hits.first().page);
+    fileItem->setFirstColumnSpanned(true);
+
+    for (const FolderSearchHit &hit : hits) {
+        auto hitItem = new QTreeWidgetItem(fileItem);
+        hitItem->setText(0, QString::number(hit.page + 1));
+        hitItem->setText(1, hit.snippet);
+        hitItem->setToolTip(1, hit.snippet);
+        hitItem->setData(0, PATH_ROLE, path);
+        hitItem->setData(0, PAGE_ROLE, hit.page);
+    }
+    _hitCount += hits.count();
+}
+
+
+void FolderSearchBar::onProgress(int searchedFiles, int listedFiles)
+{
+    _statusLabel->setText( tr("%1 matches, %2 of %3 files searched...").arg(_hitCount).arg(searchedFiles).arg(listedFiles) );
+}
+
+
+void FolderSearchBar::onFinished(bool complete)
+{
+    _searchButton->setText( tr("Search") );
+
+    QString msg = tr("%1 matches in %2 files").arg(_hitCount).arg(_results->topLevelItemCount());
+    if (!complete) {
+        msg += QLatin1String(" ") + tr("(too many: the search stopped)");
+    }
+    // the files changed since the last search, not read from the text index
+    msg += QLatin1String(", ") + tr("%1 files searched, %2 read again").arg(_search->searchedFiles()).arg(_search->extractedFiles());
+    _statusLabel->setText(msg);
+}
+
+
+void FolderSearchBar::onItemClicked(QTreeWidgetItem *item)
+{
+    Q_EMIT hitActivated( item->data(0, PATH_ROLE).toString(), item->data(0, PAGE_ROLE).toInt() );
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef FOLDERSEARCHBAR_H
+#define FOLDERSEARCHBAR_H
+
+
+#include <QDockWidget>
+#include <QVector>
+
+#include "foldersearch.h"
+
+class QCheckBox;
+class QLabel;
+class QLineEdit;
+class QPushButton;
+class QTreeWidget;
+class QTreeWidgetItem;
+
+
+// Searches the PDF files of a folder, docked beside the view.
+// Hits are listed under their file as soon as it is searched.
+class FolderSearchBar : public QDockWidget
+{
+    Q_OBJECT
+
+public:
+    explicit FolderSearchBar(QWidget *parent = nullptr);
+
+    // the folder searched, until another one is chosen
+    void setDirectory(const QString &directory);
+
+Q_SIGNALS:
+    void hitActivated(const QString &path, int page);
+
+private Q_SLOTS:
+    void chooseDirectory();
+    void startOrStop();
+
+    void onHitsFound(const QString &path, const QVector<FolderSearchHit> &hits);
+    void onProgress(int searchedFiles, int listedFiles);
+    void onFinished(bool complete);
+    void onItemClicked(QTreeWidgetItem *item);
+
+private:
+    FolderSearch* _search;
+
+    QLineEdit* _queryLineEdit;
+    QLineEdit* _directoryLineEdit;
+    QCheckBox* _caseCheckBox;
+    QCheckBox* _wordsCheckBox;
+    QCheckBox* _diacriticsCheckBox;
+    QCheckBox* _regexCheckBox;
+    QPushButton* _searchButton;
+    QTreeWidget* _results;
+    QLabel* _statusLabel;
+
+    int _hitCount;
+};
+
+#endif // FOLDERSEARCHBAR_H
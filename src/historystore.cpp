@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "historystore.h"
+
+#include "tracing.h"
+
+#include <QtConcurrent>
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+
+// the journal file format
+static const quint32 HISTORY_MAGIC = 0x43564853;
+static const quint32 HISTORY_VERSION = 1;
+
+
+bool HistoryEntry::matches(const QFileInfo &info) const
+{
+    return info.size() == size && info.lastModified() == modified;
+}
+
+
+QDataStream &operator<<(QDataStream &out, const HistoryEntry &entry)
+{
+    out << entry.path << entry.size << entry.modified
+        << qint32(entry.lastPage) << double(entry.zoom)
+        << qint32(entry.pageCount) << entry.thumbnail;
+    return out;
+}
+
+
+QDataStream &operator>>(QDataStream &in, HistoryEntry &entry)
+{
+    qint32 lastPage = 0;
+    double zoom = 1.0;
+    qint32 pageCount = 0;
+    in >> entry.path >> entry.size >> entry.modified
+       >> lastPage >> zoom
+       >> pageCount >> entry.thumbnail;
+    entry.lastPage = lastPage;
+    entry.zoom = zoom;
+    entry.pageCount = pageCount;
+    return in;
+}
+
+
+// moves entry on top of entries
+static void prependEntry(QList<HistoryEntry> &entries, const HistoryEntry &entry)
+{
+    for (int i = 0; i < entries.count(); ++i) {
+        if (entries.at(i).path == entry.path) {
+            entries.removeAt(i);
+            break;
+        }
+    }
+    entries.prepend(entry);
+    while (entries.count() > HistoryStore::MAX_ENTRIES) {
+        entries.removeLast();
+    }
+}
+
+
+// writes the journal again, with one record per entry, oldest first
+static void writeJournal(const QString &fileName, const QList<HistoryEntry> &entries)
+{
+    TRACE_SCOPE("history", "compact history");
+
+    QDir().mkpath( QFileInfo(fileName).absolutePath() );
+
+    QSaveFile compacted(fileName);
+    if (!compacted.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    QDataStream out(&compacted);
+    out.setVersion(QDataStream::Qt_5_15);
+    out << HISTORY_MAGIC << HISTORY_VERSION;
+    for (int i = entries.count() - 1; i >= 0; --i) {
+        out << entries.at(i);
+    }
+    compacted.commit();
+}
+
+
+static HistoryJournal loadJournal(const QString &fileName)
+{
+    TRACE_SCOPE("history", "load history");
+
+    HistoryJournal journal;
+    QList<HistoryEntry> &entries = journal.entries;
+    int records = 0;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return journal;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_15);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    in >> magic >> version;
+    if (magic != HISTORY_MAGIC || version != HISTORY_VERSION) {
+        return journal;
+    }
+
+    // the records are replayed in order: a truncated last one is dropped
+    while (!in.atEnd()) {
+        HistoryEntry entry;
+        in >> entry;
+        if (in.status() != QDataStream::Ok) {
+            break;
+        }
+        prependEntry(entries, entry);
+        ++records;
+    }
+    file.close();
+
+    // a journal grown well past its entries is written again
+    if (records > 2 * entries.count()) {
+        writeJournal(fileName, entries);
+        records = entries.count();
+    }
+
+    journal.records = records;
+    return journal;
+}
+
+
+static void appendRecord(const QString &fileName, const HistoryEntry &entry)
+{
+    TRACE_SCOPE("history", "append history record");
+
+    QDir().mkpath( QFileInfo(fileName).absolutePath() );
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_15);
+    if (file.size() == 0) {
+        out << HISTORY_MAGIC << HISTORY_VERSION;
+    }
+    out << entry;
+}
+
+
+HistoryStore::HistoryStore(const QString &fileName, QObject *parent)
+    : QObject(parent)
+    , _fileName(fileName)
+    , _loaded(false)
+    , _records(0)
+    , _loadWatcher(nullptr)
+{
+    _writer.setMaxThreadCount(1);
+}
+
+
+HistoryStore::~HistoryStore()
+{
+    _writer.waitForDone();
+}
+
+
+void HistoryStore::load()
+{
+    if (_loaded || _loadWatcher) {
+        return;
+    }
+
+    // the records appended meanwhile are queued after the load
+    _loadWatcher = new QFutureWatcher<HistoryJournal>(this);
+    connect(_loadWatcher, &QFutureWatcherBase::finished, this, &HistoryStore::onLoadFinished);
+    _loadWatcher->setFuture( QtConcurrent::run(&_writer, loadJournal, _fileName) );
+}
+
+
+HistoryEntry HistoryStore::entry(const QString &path) const
+{
+    for (const HistoryEntry &entry : _entries) {
+        if (entry.path == path) {
+            return entry;
+        }
+    }
+    return HistoryEntry();
+}
+
+
+void HistoryStore::update(const HistoryEntry &entry)
+{
+    if (entry.path.isEmpty()) {
+        return;
+    }
+
+    prependEntry(_entries, entry);
+    if (!_loaded) {
+        _updates.append(entry);
+    }
+
+    // the images are implicitly shared: the writer gets a snapshot of entry
+    // (or of them all, when the records grew well past the entries:
+    // reloads of a file being rebuilt update it over and over)
+    if (_loaded && _records + 1 > 2 * _entries.count()) {
+        QtConcurrent::run(&_writer, writeJournal, _fileName, _entries);
+        _records = _entries.count();
+    } else {
+        QtConcurrent::run(&_writer, appendRecord, _fileName, entry);
+        ++_records;
+    }
+
+    Q_EMIT changed();
+}
+
+
+void HistoryStore::onLoadFinished()
+{
+    const HistoryJournal journal = _loadWatcher->result();
+    _entries = journal.entries;
+    _records += journal.records;
+    _loadWatcher->deleteLater();
+    _loadWatcher = nullptr;
+
+    // what changed while loading is newer than what was loaded
+    for (const HistoryEntry &entry : qAsConst(_updates)) {
+        prependEntry(_entries, entry);
+    }
+    _updates.clear();
+    _loaded = true;
+
+    Q_EMIT loaded();
+    Q_EMIT changed();
+}
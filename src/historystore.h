@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef HISTORYSTORE_H
+#define HISTORYSTORE_H
+
+
+#include <QDateTime>
+#include <QFutureWatcher>
+#include <QImage>
+#include <QList>
+#include <QObject>
+#include <QThreadPool>
+
+class QDataStream;
+class QFileInfo;
+
+
+// What is remembered of an opened file
+struct HistoryEntry
+{
+    QString path;
+    qint64 size = -1;
+    QDateTime modified;
+
+    // where it was left
+    int lastPage = 0;
+    qreal zoom = 1.0;
+
+    int pageCount = 0;
+    QImage thumbnail;
+
+    // true if the file did not change since the entry was written
+    bool matches(const QFileInfo &info) const;
+};
+
+QDataStream &operator<<(QDataStream &out, const HistoryEntry &entry);
+QDataStream &operator>>(QDataStream &in, HistoryEntry &entry);
+
+
+// The entries read from the journal, and the records it holds
+struct HistoryJournal
+{
+    QList<HistoryEntry> entries;
+    int records = 0;
+};
+
+
+// The opened files, most recent first.
+// The store is a journal: every update appends one record to the file,
+// from a background thread, and the journal is compacted when loaded, or
+// written again once its records are more than twice the entries.
+// It is loaded once, in background too: updates made in the meantime
+// are kept over what is loaded.
+class HistoryStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    // files remembered, at most
+    static const int MAX_ENTRIES = 50;
+
+    explicit HistoryStore(const QString &fileName, QObject *parent = nullptr);
+
+    // waits for the pending writes
+    ~HistoryStore();
+
+    void load();
+    inline bool isLoaded() const { return _loaded; }
+
+    inline QList<HistoryEntry> entries() const { return _entries; }
+
+    // the entry of path (with an empty path, if there is none)
+    HistoryEntry entry(const QString &path) const;
+
+    // adds or replaces the entry of its path, moving it to the top
+    void update(const HistoryEntry &entry);
+
+Q_SIGNALS:
+    void loaded();
+    void changed();
+
+private Q_SLOTS:
+    void onLoadFinished();
+
+private:
+    const QString _fileName;
+    QList<HistoryEntry> _entries;
+
+    // the updates made while loading
+    QList<HistoryEntry> _updates;
+    bool _loaded;
+
+    // the records in the journal file, once written
+    int _records;
+
+    // loads and writes, in order, one at a time
+    QThreadPool _writer;
+    QFutureWatcher<HistoryJournal>* _loadWatcher;
+};
+
+#endif // HISTORYSTORE_H
@@ -8,20 +8,49 @@
 
 
 #include "application.h"
+#include "startuptrace.h"
+#include "tracing.h"
 
 #include "config.h"
 
 
+// the headless modes never show a window, and
+// have not to depend on a display being available
+static bool isHeadless(int argc, char *argv[])
+{
+    for (int i = 1; i < argc; ++i) {
+        const QByteArray arg(argv[i]);
+        if (arg == "--render" || arg.startsWith("--render=") || arg == "--extract-text") {
+            return true;
+        }
+    }
+    return false;
+}
+
+
 int main(int argc, char *argv[])
 {
-    Application app(argc,argv);
-    
+    StartupTrace::mark( QStringLiteral("main") );
+
+    Trace::start( QString::fromLocal8Bit( qgetenv("CUTEVIEWER_TRACE") ) );
+
+    if (isHeadless(argc, argv) && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    // before the application: its settings and data are read by name
     QCoreApplication::setApplicationName( QStringLiteral(PROJECT_NAME) );
     QCoreApplication::setApplicationVersion( QStringLiteral(PROJECT_VERSION) );
     QCoreApplication::setOrganizationName( QStringLiteral("adjam") );
     QCoreApplication::setOrganizationDomain( QStringLiteral("adjam.org") );
 
+    Application app(argc,argv);
+    StartupTrace::mark( QStringLiteral("QApplication") );
+
     app.parseCommandlineArgs();
 
-    return app.exec();
+    const int result = app.exec();
+
+    Trace::stop();
+    return result;
 }
@@ -10,23 +10,49 @@
 #include "mainwindow.h"
 
 #include "application.h"
+#include "colortransform.h"
+#include "documentloader.h"
+#include "documentregistry.h"
+#include "filesaver.h"
+#include "foldersearchbar.h"
+#include "historystore.h"
+#include "memorygovernor.h"
+#include "pagematcher.h"
+#include "pageview.h"
+#include "prefetcher.h"
+#include "printjob.h"
+#include "rendercache.h"
 #include "searchbar.h"
+#include "searchengine.h"
 #include "settingsdialog.h"
+#include "settingsstore.h"
+#include "startuptrace.h"
 #include "statusbar.h"
+#include "thumbnailbar.h"
+#include "thumbnailmodel.h"
+#include "tracing.h"
 
 #include <QLinkedList>
 #include <QImage>
 #include <QPixmap>
 
 #include <QCloseEvent>
+#include <QDialogButtonBox>
+#include <QFile>
 #include <QFileDialog>
+#include <QFileInfo>
+#include <QFormLayout>
+#include <QtMath>
+#include <QActionGroup>
+#include <QLabel>
 #include <QMenu>
 #include <QMenuBar>
 #include <QMessageBox>
 #include <QScreen>
-#include <QSettings>
+#include <QSpinBox>
 #include <QStandardPaths>
 #include <QStatusBar>
+#include <QTimer>
 #include <QToolBar>
 #include <QVBoxLayout>
 
@@ -34,49 +60,102 @@
 
 #include <QPrinter>
 #include <QPrintDialog>
+#include <QProgressDialog>
 
 #include <QPdfBookmarkModel>
 #include <QPdfDocument>
-#include <QPdfPageNavigation>
-#include <QPdfView>
 
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
-    , _view(new QPdfView(this))
+    , _view(new PageView(Application::instance()->renderCache(), this))
     , _document(new QPdfDocument(this))
-    , _searchBar(new SearchBar(this))
+    , _loader(new DocumentLoader(this))
+    , _fileSaver(new FileSaver(this))
+    , _searchBar(nullptr)
+    , _searchEngine(new SearchEngine(this))
     , _statusBar(new StatusBar(this))
+    , _thumbnailBar(nullptr)
+    , _folderSearchBar(nullptr)
+    , _printJob(nullptr)
+    , _diagnosticsTimer(new QTimer(this))
+    , _colorModeActions(nullptr)
+    , _pageMatcher(new PageMatcher(Application::instance()->documentRegistry(), this))
+    , _reloadTimer(new QTimer(this))
+    , _reloading(false)
+    , _autoReload(true)
+    , _pendingDocument(nullptr)
+    , _recentFilesDirty(true)
     , _zoomRange(0)
+    , _startPage(-1)
     , _canBeReloaded(true)
 {
     setAttribute(Qt::WA_DeleteOnClose);
 
     _view->setDocument(_document);
+
+    // pages about to be shown are rendered in advance
+    new Prefetcher(_view, Application::instance()->renderCache());
     
     // The UI
     QWidget* w = new QWidget(this);
     auto layout = new QVBoxLayout;
     layout->setContentsMargins (0, 0, 0, 0);
     layout->addWidget (_view);
-    layout->addWidget (_searchBar);
     w->setLayout (layout);
     setCentralWidget(w);
 
-    // let's start with the hidden bar(s)
-    _searchBar->setVisible(false);
+    connect(_loader, &DocumentLoader::loaded, this, &MainWindow::onDocumentLoaded);
+    connect(_loader, &DocumentLoader::failed, this, &MainWindow::onDocumentLoadFailed);
+    connect(_loader, &DocumentLoader::contentHashReady, this, &MainWindow::onContentHashReady);
+    connect(_loader, &DocumentLoader::pageCountChanged, this, [=] (int pageCount) {
+            // a new version of the document shown is loaded quietly
+            if (_reloading) {
+                return;
+            }
+            setWindowTitle( tr("Loading %1 pages...").arg(pageCount) );
+        }
+    );
 
-    connect(_searchBar, &SearchBar::search, this, &MainWindow::search);
-    connect(this, &MainWindow::searchMessage, _searchBar, &SearchBar::searchMessage);
+    connect(_view, &PageView::currentPageChanged, this, &MainWindow::updateStatusBar);
+
+    connect(Application::instance()->historyStore(), &HistoryStore::changed, this, [=] () {
+            _recentFilesDirty = true;
+        }
+    );
+    connect(qApp, &QCoreApplication::aboutToQuit, this, &MainWindow::recordHistory);
+
+    // files are written in many steps: they are reloaded once they stay
+    // untouched for a while
+    _reloadTimer->setSingleShot(true);
+    _reloadTimer->setInterval(500);
+    connect(_reloadTimer, &QTimer::timeout, this, &MainWindow::reloadDocument);
+    connect(Application::instance(), &Application::watchedFileChanged, this, &MainWindow::onWatchedFileChanged);
+    connect(_pageMatcher, &PageMatcher::matched, this, &MainWindow::onPagesMatched);
+
+    DocumentRegistry* registry = Application::instance()->documentRegistry();
+    connect(registry, &DocumentRegistry::contentHashReady, this, &MainWindow::applyContentHash);
+    connect(registry, &DocumentRegistry::replaced, this, &MainWindow::onDocumentReplaced);
+
+    // the diagnostics are refreshed at a fixed pace, not on every event
+    _diagnosticsTimer->setInterval(500);
+    connect(_diagnosticsTimer, &QTimer::timeout, this, &MainWindow::updateDiagnostics);
+
+    connect(_searchEngine, &SearchEngine::message, this, &MainWindow::searchMessage);
+    connect(_searchEngine, &SearchEngine::matchFound, this, [=] (int page) {
+            _view->setCurrentPage(page);
+        }
+    );
 
     // restore geometry and state
-    QSettings s;
-    restoreGeometry( s.value( QStringLiteral("geometry") ).toByteArray() );
-    restoreState( s.value( QStringLiteral("myWidget/windowState") ).toByteArray() );
+    SettingsStore* s = Application::instance()->settings();
+    restoreGeometry( s->value( QStringLiteral("geometry") ).toByteArray() );
+    restoreState( s->value( QStringLiteral("myWidget/windowState") ).toByteArray() );
 
     // we need to load settings BEFORE setup actions,
     // to SET initial states
     loadSettings();
+    connect(s, &SettingsStore::changed, this, &MainWindow::applySettings);
 
     setupActions();
 
@@ -90,13 +169,165 @@ MainWindow::MainWindow(QWidget *parent)
     statusBar()->addWidget(_statusBar);
 
     updateStatusBar();
+
+    connect(_view, &PageView::firstPagePainted, this, [] () {
+            StartupTrace::mark( QStringLiteral("first page painted") );
+            StartupTrace::report();
+        }
+    );
+
+    // what is not visible at first is completed when the window is idle
+    QTimer::singleShot(0, this, &MainWindow::loadDeferredIcons);
+}
+
+
+void MainWindow::deferIcon(QAction *action, const QString &iconName)
+{
+    _deferredIcons.append( qMakePair(action, iconName) );
+}
+
+
+void MainWindow::loadDeferredIcons()
+{
+    for (const auto &icon : qAsConst(_deferredIcons)) {
+        const QString resource = QLatin1String(":/icons/") + icon.second + QLatin1String(".svg");
+        icon.first->setIcon( QIcon::fromTheme( icon.second, QIcon(resource) ) );
+    }
+    _deferredIcons.clear();
+}
+
+
+SearchBar* MainWindow::searchBar()
+{
+    if (_searchBar) {
+        return _searchBar;
+    }
+
+    // built on first use
+    _searchBar = new SearchBar(this);
+    _searchBar->setVisible(false);
+    centralWidget()->layout()->addWidget(_searchBar);
+
+    connect(_searchBar, &SearchBar::search, this, &MainWindow::search);
+    connect(this, &MainWindow::searchMessage, _searchBar, &SearchBar::searchMessage);
+
+    return _searchBar;
+}
+
+
+ThumbnailBar* MainWindow::thumbnailBar()
+{
+    if (_thumbnailBar) {
+        return _thumbnailBar;
+    }
+
+    // built on first use
+    _thumbnailBar = new ThumbnailBar(Application::instance()->renderCache(), this);
+    _thumbnailBar->setVisible(false);
+    addDockWidget(Qt::LeftDockWidgetArea, _thumbnailBar);
+
+    _thumbnailBar->setDocument(_document);
+    if (!_contentHash.isEmpty()) {
+        _thumbnailBar->setContentHash(_contentHash);
+    }
+    _thumbnailBar->setCurrentPage( _view->currentPage() );
+
+    connect(_thumbnailBar, &ThumbnailBar::pageActivated, _view, &PageView::setCurrentPage);
+    connect(_view, &PageView::currentPageChanged, _thumbnailBar, &ThumbnailBar::setCurrentPage);
+
+    return _thumbnailBar;
+}
+
+
+FolderSearchBar* MainWindow::folderSearchBar()
+{
+    if (_folderSearchBar) {
+        return _folderSearchBar;
+    }
+
+    // built on first use
+    _folderSearchBar = new FolderSearchBar(this);
+    _folderSearchBar->setVisible(false);
+    addDockWidget(Qt::RightDockWidgetArea, _folderSearchBar);
+
+    // the hits open in the window showing their file, if any
+    connect(_folderSearchBar, &FolderSearchBar::hitActivated, this, [=] (const QString &path, int page) {
+            Application::instance()->loadPath(path, page);
+        }
+    );
+
+    return _folderSearchBar;
+}
+
+
+MainWindow::~MainWindow()
+{
+    // background jobs still working on the document have to be stopped
+    if (_printJob) {
+        _printJob->cancel();
+    }
+    _fileSaver->stop();
+    _pageMatcher->cancel();
+    _searchEngine->clear();
+    dropPendingDocument();
+    Application::instance()->documentRegistry()->release(_document);
+    Application::instance()->removeWatchedPath(_watchedPath);
 }
 
 
 void MainWindow::loadSettings()
+{
+    TRACE_SCOPE("settings", "load window settings");
+
+    applySettings( QStringList() << QStringLiteral("MemoryMappedFiles")
+                                 << QStringLiteral("AutoReload")
+                                 << QStringLiteral("ShowDiagnostics")
+                                 << QStringLiteral("ColorMode") );
+}
+
+
+void MainWindow::applySettings(const QStringList &keys)
 {
     // the settings object
-    QSettings s;
+    SettingsStore* s = Application::instance()->settings();
+
+    if (keys.contains( QStringLiteral("MemoryMappedFiles") )) {
+        bool memoryMapped = s->value( QStringLiteral("MemoryMappedFiles"), true).toBool();
+        _loader->setMemoryMapped(memoryMapped);
+    }
+
+    if (keys.contains( QStringLiteral("AutoReload") )) {
+        // files reloaded on change are copied, not mapped: the documents
+        // opened before keep their mapping, and are not reloaded
+        _autoReload = s->value( QStringLiteral("AutoReload"), true).toBool();
+        _loader->setCopiedInMemory(_autoReload);
+        if (!_autoReload) {
+            _reloadTimer->stop();
+        }
+        updateWatchedPath();
+    }
+
+    if (keys.contains( QStringLiteral("ShowDiagnostics") )) {
+        bool showDiagnostics = s->value( QStringLiteral("ShowDiagnostics"), false).toBool();
+        _statusBar->setDiagnosticsVisible(showDiagnostics);
+        if (showDiagnostics) {
+            updateDiagnostics();
+            _diagnosticsTimer->start();
+        } else {
+            _diagnosticsTimer->stop();
+        }
+    }
+
+    if (keys.contains( QStringLiteral("ColorMode") )) {
+        const int colorMode = ColorTransform::mode( s->value( QStringLiteral("ColorMode"), 0).toInt() );
+        _view->setColorMode(colorMode);
+        if (_colorModeActions) {
+            const QList<QAction*> actions = _colorModeActions->actions();
+            for (QAction* action : actions) {
+                action->setChecked( action->data().toInt() == colorMode );
+            }
+        }
+    }
 }
 
 
@@ -118,32 +349,374 @@ void MainWindow::tile(const QMainWindow *previous)
 }
 
 
-void MainWindow::loadFilePath(const QString &path)
+void MainWindow::loadFilePath(const QString &path, int page)
 {
-    QGuiApplication::setOverrideCursor(Qt::WaitCursor);
+    recordHistory();
+    _startPage = page;
+
+    _reloadTimer->stop();
+    _reloading = false;
+    dropPendingDocument();
+
+    // already open in another window: shared, not loaded again
+    QPdfDocument* shared = Application::instance()->documentRegistry()->acquire(path);
+    if (shared) {
+        _loader->cancel();
+        _searchEngine->clear();
+        setCurrentFilePath(path);
+        showDocument(shared, Application::instance()->documentRegistry()->title(shared));
+        return;
+    }
+
+    // the document is opened in background: a previous load
+    // still running is dropped by the loader
+    _loader->load(path);
+    _searchEngine->clear();
 
-    _document->load(path);
-    const auto documentTitle = _document->metaData(QPdfDocument::Title).toString();
-    setWindowTitle(!documentTitle.isEmpty() ? documentTitle : QStringLiteral("PDF Viewer"));
-            
-    QGuiApplication::restoreOverrideCursor();
+    _view->setCursor(Qt::BusyCursor);
+    setWindowTitle( tr("Loading...") );
 
     setCurrentFilePath(path);
     updateStatusBar();
 }
 
 
-void MainWindow::saveFilePath(const QString &path)
+void MainWindow::onDocumentLoaded(QPdfDocument *document, const QString &title)
 {
-    QGuiApplication::setOverrideCursor(Qt::WaitCursor);
-    // TODO
-    QGuiApplication::restoreOverrideCursor();
+    StartupTrace::mark( QStringLiteral("first document loaded") );
 
-    setCurrentFilePath(path);
+    // a new version: shown once its pages are matched with the current ones
+    if (_reloading) {
+        _reloading = false;
+        dropPendingDocument();
+
+        document->setParent(this);
+        _pendingDocument = document;
+        _pendingTitle = title;
+        _pageMatcher->match(document);
+        return;
+    }
+
+    // the same file may have been opened by another window meanwhile
+    document = Application::instance()->documentRegistry()->add(_filePath, document, title);
+    showDocument(document, title);
+}
+
+
+void MainWindow::showDocument(QPdfDocument *document, const QString &title)
+{
+    setDocument(document);
+
+    _view->unsetCursor();
+    setWindowTitle(!title.isEmpty() ? title : QStringLiteral("PDF Viewer"));
+
+    // known already, when the document is shared
+    const QByteArray hash = Application::instance()->documentRegistry()->contentHash(document);
+    if (!hash.isEmpty()) {
+        applyContentHash(document, hash);
+    }
+
+    // a document shared with another window may be mapped
+    updateWatchedPath();
+
+    restoreFromHistory();
+    updateStatusBar();
+}
+
+
+void MainWindow::restoreFromHistory()
+{
+    HistoryStore* history = Application::instance()->historyStore();
+    if (!history->isLoaded()) {
+        connect(history, &HistoryStore::loaded, this, &MainWindow::restoreFromHistory, Qt::UniqueConnection);
+        return;
+    }
+    disconnect(history, &HistoryStore::loaded, this, &MainWindow::restoreFromHistory);
+
+    const int pageCount = _document->pageCount();
+    if (_filePath.isEmpty() || pageCount == 0) {
+        return;
+    }
+
+    // back where it was left, unless the file changed since
+    const HistoryEntry entry = history->entry(_filePath);
+    if (!entry.path.isEmpty() && entry.matches( QFileInfo(_filePath) )) {
+        // the zoom of a damaged record is left alone
+        if (qIsFinite(entry.zoom) && entry.zoom > 0) {
+            _zoomRange = qBound(-6, qRound( qLn(entry.zoom) / qLn(1.25) ), 10);
+            _view->setZoomFactor( qPow(1.25, _zoomRange) );
+        }
+        _view->setCurrentPage( qBound(0, entry.lastPage, pageCount - 1) );
+        updateStatusBar();
+    }
+
+    // asked for, by a search in folder
+    if (_startPage >= 0) {
+        _view->setCurrentPage( qBound(0, _startPage, pageCount - 1) );
+        _startPage = -1;
+        updateStatusBar();
+    }
+
+    recordHistory();
+}
+
+
+void MainWindow::showPage(int page)
+{
+    if (page < 0) {
+        return;
+    }
+
+    // not shown yet: the page is set once the history is restored
+    if (_loader->isLoading() || _document->pageCount() == 0
+        || !Application::instance()->historyStore()->isLoaded()) {
+        _startPage = page;
+        return;
+    }
+
+    _view->setCurrentPage( qBound(0, page, _document->pageCount() - 1) );
     updateStatusBar();
 }
 
 
+void MainWindow::setDocument(QPdfDocument *document, bool keepPosition)
+{
+    if (_printJob) {
+        _printJob->cancel();
+    }
+    // a copy of the file goes on, whatever the document shown
+    _fileSaver->stopPageSave();
+    if (document != _pendingDocument) {
+        dropPendingDocument();
+    }
+    _pageMatcher->setDocument(document);
+
+    _searchEngine->setDocument(document);
+    _view->setDocument(document, keepPosition);
+    if (_thumbnailBar) {
+        _thumbnailBar->setDocument(document);
+    }
+    _contentHash.clear();
+
+    // the other windows showing it keep it alive
+    Application::instance()->documentRegistry()->release(_document);
+    _document = document;
+}
+
+
+void MainWindow::dropPendingDocument()
+{
+    if (!_pendingDocument) {
+        return;
+    }
+
+    _pageMatcher->cancelMatch();
+    delete _pendingDocument;
+    _pendingDocument = nullptr;
+    _pendingContentHash.clear();
+}
+
+
+void MainWindow::onDocumentLoadFailed(const QString &path, const QString &error)
+{
+    // the version shown stays: the next change may fix it
+    if (_reloading) {
+        _reloading = false;
+        statusBar()->showMessage( tr("Cannot reload %1: %2").arg(path, error) );
+        return;
+    }
+
+    _view->unsetCursor();
+    setWindowTitle( QStringLiteral("PDF Viewer") );
+    setCurrentFilePath( QLatin1String("") );
+
+    statusBar()->showMessage( tr("Cannot open %1: %2").arg(path, error) );
+}
+
+
+void MainWindow::onContentHashReady(QPdfDocument *document, const QByteArray &hash)
+{
+    if (document == _pendingDocument) {
+        _pendingContentHash = hash;
+        return;
+    }
+    if (document != _document) {
+        return;
+    }
+
+    // every window showing document gets it
+    Application::instance()->documentRegistry()->setContentHash(document, hash);
+}
+
+
+void MainWindow::applyContentHash(QPdfDocument *document, const QByteArray &hash)
+{
+    if (document != _document) {
+        return;
+    }
+
+    _contentHash = hash;
+    if (_thumbnailBar) {
+        _thumbnailBar->setContentHash(hash);
+    }
+}
+
+
+// true if path looks like a whole PDF file, not one still being written
+static bool isCompletePdf(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly) || file.size() < 16) {
+        return false;
+    }
+    if (!file.read(5).startsWith("%PDF-")) {
+        return false;
+    }
+
+    // the end of file marker is in the last bytes, maybe followed by a newline
+    file.seek( qMax(qint64(0), file.size() - 1024) );
+    return file.readAll().contains("%%EOF");
+}
+
+
+void MainWindow::onWatchedFileChanged(const QString &path)
+{
+    // another window may watch the file this one maps
+    if (path.isEmpty() || path != _watchedPath) {
+        return;
+    }
+
+    // the version shown is fingerprinted while the new one is written
+    _pageMatcher->prepare();
+
+    // every write starts the wait again
+    _reloadTimer->start();
+}
+
+
+void MainWindow::reloadDocument()
+{
+    TRACE_SCOPE("reload", "reload document");
+
+    if (_filePath.isEmpty()) {
+        return;
+    }
+
+    // another file is being opened
+    if (_loader->isLoading() && !_reloading) {
+        return;
+    }
+
+    // still being written, or the document is busy: later
+    if (_printJob || _fileSaver->isSaving() || !isCompletePdf(_filePath)) {
+        _reloadTimer->start();
+        return;
+    }
+
+    _reloading = true;
+    _loader->load(_filePath);
+}
+
+
+void MainWindow::onPagesMatched(QPdfDocument *document, const QHash<int, int> &unchangedPages)
+{
+    if (document != _pendingDocument) {
+        return;
+    }
+
+    // the renders of the pages that did not change stay, under the new document
+    Application::instance()->renderCache()->movePages(_document, document, unchangedPages);
+
+    // the other windows showing the previous version switch too
+    DocumentRegistry* registry = Application::instance()->documentRegistry();
+    registry->replace(_document, document, _filePath, _pendingTitle);
+
+    const QByteArray hash = _pendingContentHash;
+    _pendingDocument = nullptr;
+    _pendingContentHash.clear();
+
+    setDocument(document, true);
+    setWindowTitle(!_pendingTitle.isEmpty() ? _pendingTitle : QStringLiteral("PDF Viewer"));
+    if (!hash.isEmpty()) {
+        registry->setContentHash(document, hash);
+    }
+
+    const int pageCount = document->pageCount();
+    statusBar()->showMessage( tr("Reloaded: %1 of %2 pages changed").arg(pageCount - unchangedPages.count()).arg(pageCount), 5000 );
+
+    recordHistory();
+    updateStatusBar();
+}
+
+
+void MainWindow::onDocumentReplaced(QPdfDocument *from, QPdfDocument *to)
+{
+    // the window that reloaded it switches on its own
+    if (from != _document || to == _pendingDocument) {
+        return;
+    }
+
+    // a reload of our own is not needed anymore
+    _reloadTimer->stop();
+    if (_reloading) {
+        _loader->cancel();
+        _reloading = false;
+    }
+    dropPendingDocument();
+
+    setDocument(to, true);
+    const QString title = Application::instance()->documentRegistry()->title(to);
+    setWindowTitle(!title.isEmpty() ? title : QStringLiteral("PDF Viewer"));
+    updateStatusBar();
+}
+
+
+void MainWindow::saveFilePath(const QString &path)
+{
+    // documents are not edited: the file shown is already saved
+    if (_filePath.isEmpty() || _fileSaver->isSaving()
+        || QFileInfo(path).canonicalFilePath() == QFileInfo(_filePath).canonicalFilePath()) {
+        return;
+    }
+
+    // another file may be shown by the time the copy ends
+    const QString source = _filePath;
+    QProgressDialog* progress = saveProgressDialog( tr("Saving %1...").arg( QFileInfo(path).fileName() ) );
+    connect(_fileSaver, &FileSaver::finished, progress, [=] (bool ok) {
+            if (ok && _filePath == source) {
+                setCurrentFilePath(path);
+                updateStatusBar();
+            }
+        }
+    );
+
+    _fileSaver->copyFile(_filePath, path);
+}
+
+
+QProgressDialog* MainWindow::saveProgressDialog(const QString &label)
+{
+    // progress is in per mille: byte counts do not fit an int
+    QProgressDialog* progress = new QProgressDialog(label, tr("Cancel"), 0, 1000, this);
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setMinimumDuration(500);
+    progress->setAutoReset(false);
+
+    connect(_fileSaver, &FileSaver::progress, progress, [=] (qint64 done, qint64 total) {
+            progress->setValue( total > 0 ? int(done * 1000 / total) : 0 );
+        }
+    );
+    connect(progress, &QProgressDialog::canceled, _fileSaver, &FileSaver::cancel);
+    connect(_fileSaver, &FileSaver::finished, progress, [=] (bool ok, const QString &error) {
+            statusBar()->showMessage(ok ? tr("Document saved") : tr("Document not saved: %1").arg(error), 5000);
+            progress->deleteLater();
+        }
+    );
+
+    return progress;
+}
+
+
 bool MainWindow::exitAfterSaving()
 {
     if (isWindowModified()) {
@@ -177,14 +750,30 @@ bool MainWindow::exitAfterSaving()
 }
 
 
+void MainWindow::showEvent(QShowEvent *event)
+{
+    QMainWindow::showEvent(event);
+
+    StartupTrace::mark( QStringLiteral("first window shown") );
+
+    // no page to wait for
+    if (_filePath.isEmpty()) {
+        StartupTrace::report();
+    }
+}
+
+
 void MainWindow::closeEvent(QCloseEvent *event)
 {
     if (exitAfterSaving()) {
-        QSettings s;
-        s.setValue( QStringLiteral("geometry") , saveGeometry());
-        s.setValue( QStringLiteral("windowState") , saveState());
+        recordHistory();
+        _loader->cancel();
 
-//        Application::instance()->removeWindowFromList(this);
+        SettingsStore* s = Application::instance()->settings();
+        s->setValue( QStringLiteral("geometry") , saveGeometry());
+        s->setValue( QStringLiteral("windowState") , saveState());
+
+        Application::instance()->removeWindowFromList(this);
         event->accept();
         return;
     }
@@ -196,8 +785,9 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
 {
     if (event->key() == Qt::Key_Escape) {
 
-        if (_searchBar->isVisible()) {
+        if (_searchBar && _searchBar->isVisible()) {
             _searchBar->hide();
+            _searchEngine->stopSearch();
             event->accept();
             return;
         }
@@ -211,7 +801,8 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
 void MainWindow::setupActions()
 {
     // ------------------------------------------------------------------------------------------------------------------------
-    // Create and set ALL the needed actions
+    // Create and set ALL the needed actions.
+    // Only the toolbar ones get their icon now: menu icons are loaded when the window is idle
 
     // file actions -----------------------------------------------------------------------------------------------------------
 
@@ -223,21 +814,31 @@ void MainWindow::setupActions()
     // RECENT FILES
     QMenu* menuRecentFiles = new QMenu( tr("Recent Files"), this);
     connect(menuRecentFiles, &QMenu::aboutToShow, this, [=] () {
-            QSettings s;
-            QStringList recentFiles = s.value( QStringLiteral("recentFiles") ).toStringList();
-            if (recentFiles.count() == 0) {
-                QAction* voidAction = new QAction( tr("no recent files"), this);
-                menuRecentFiles->addAction(voidAction);
+            if (!_recentFilesDirty) {
+                return;
+            }
+            _recentFilesDirty = false;
+
+            // clear() deletes the actions owned by the menu
+            menuRecentFiles->clear();
+
+            const QList<HistoryEntry> entries = Application::instance()->historyStore()->entries();
+            if (entries.isEmpty()) {
+                QAction* voidAction = menuRecentFiles->addAction( tr("no recent files") );
+                voidAction->setEnabled(false);
                 return;
             }
-            for (const QString &path : qAsConst(recentFiles)) {
-                QAction* recentFileAction = new QAction(path, this);
-                menuRecentFiles->addAction(recentFileAction);
+            for (int i = 0; i < qMin(entries.count(), 10); ++i) {
+                const HistoryEntry &entry = entries.at(i);
+                QAction* recentFileAction = menuRecentFiles->addAction(entry.path);
+                recentFileAction->setData(entry.path);
+                if (!entry.thumbnail.isNull()) {
+                    recentFileAction->setIcon( QIcon( QPixmap::fromImage(entry.thumbnail) ) );
+                }
                 connect(recentFileAction, &QAction::triggered, this, &MainWindow::recentFileTriggered);
             }
         }
     );
-    connect(menuRecentFiles, &QMenu::aboutToHide, menuRecentFiles, &QMenu::clear);
 
     // SAVE
     QAction* actionSave = new QAction( QIcon::fromTheme( QStringLiteral("document-save"), QIcon( QStringLiteral(":/icons/document-save.svg") ) ) , tr("Save"), this);
@@ -246,64 +847,125 @@ void MainWindow::setupActions()
     actionSave->setEnabled(false);
 
     // SAVE AS
-    QAction* actionSaveAs = new QAction( QIcon::fromTheme( QStringLiteral("document-save-as"), QIcon( QStringLiteral(":/icons/document-save-as.svg") ) ) , tr("Save As"), this);
+    QAction* actionSaveAs = new QAction( tr("Save As"), this);
+    deferIcon(actionSaveAs, QStringLiteral("document-save-as") );
     connect(actionSaveAs, &QAction::triggered, this, &MainWindow::saveFileAs);
 
+    // EXPORT PAGES (as images)
+    QAction* actionSavePages = new QAction( tr("Export Pages as Images..."), this);
+    connect(actionSavePages, &QAction::triggered, this, &MainWindow::savePages);
+
     // PRINT
     QAction* actionPrint = new QAction( QIcon::fromTheme( QStringLiteral("document-print"), QIcon( QStringLiteral(":/icons/document-print.svg") ) ) , tr("Print"), this);
     actionPrint->setShortcut(QKeySequence::Print);
     connect(actionPrint, &QAction::triggered, this, &MainWindow::printFile);
 
     // CLOSE
-    QAction* actionClose = new QAction( QIcon::fromTheme( QStringLiteral("document-close"), QIcon( QStringLiteral(":/icons/document-close.svg") ) ) , tr("Close"), this);
+    QAction* actionClose = new QAction( tr("Close"), this);
+    deferIcon(actionClose, QStringLiteral("document-close") );
     actionClose->setShortcut(QKeySequence::Close);
     connect(actionClose, &QAction::triggered, this, &MainWindow::close);
 
     // QUIT
-    QAction* actionQuit = new QAction( QIcon::fromTheme( QStringLiteral("application-exit"), QIcon( QStringLiteral(":/icons/application-exit.svg") ) ) , tr("Exit"), this );
+    QAction* actionQuit = new QAction( tr("Exit"), this);
+    deferIcon(actionQuit, QStringLiteral("application-exit") );
     actionQuit->setShortcut(QKeySequence::Quit);
     connect(actionQuit, &QAction::triggered, qApp, &QApplication::quit, Qt::QueuedConnection);
 
     // view actions -----------------------------------------------------------------------------------------------------------
     // ZOOM IN
-    QAction* actionZoomIn = new QAction( QIcon::fromTheme( QStringLiteral("zoom-in"), QIcon( QStringLiteral(":/icons/zoom-in.svg") ) ) , tr("Zoom In"), this );
+    QAction* actionZoomIn = new QAction( tr("Zoom In"), this);
+    deferIcon(actionZoomIn, QStringLiteral("zoom-in") );
     actionZoomIn->setShortcut(QKeySequence::ZoomIn);
     connect(actionZoomIn, &QAction::triggered, this, &MainWindow::onZoomIn );
 
     // ZOOM OUT
-    QAction* actionZoomOut = new QAction( QIcon::fromTheme( QStringLiteral("zoom-out") , QIcon( QStringLiteral(":/icons/zoom-out.svg") ) ) , tr("Zoom Out"), this );
+    QAction* actionZoomOut = new QAction( tr("Zoom Out"), this);
+    deferIcon(actionZoomOut, QStringLiteral("zoom-out") );
     actionZoomOut->setShortcut(QKeySequence::ZoomOut);
     connect(actionZoomOut, &QAction::triggered, this, &MainWindow::onZoomOut );
 
     // ZOOM ORIGINAL
-    QAction* actionZoomOriginal = new QAction( QIcon::fromTheme( QStringLiteral("zoom-original") , QIcon( QStringLiteral(":/icons/zoom-original.svg") ) ) , tr("Zoom Original"), this );
+    QAction* actionZoomOriginal = new QAction( tr("Zoom Original"), this);
+    deferIcon(actionZoomOriginal, QStringLiteral("zoom-original") );
     actionZoomOriginal->setShortcut(Qt::CTRL + Qt::Key_0);
     connect(actionZoomOriginal, &QAction::triggered, this, &MainWindow::onZoomOriginal );
 
     // FULL SCREEN
-    QAction* actionFullScreen = new QAction( QIcon::fromTheme( QStringLiteral("view-fullscreen") , QIcon( QStringLiteral(":/icons/view-fullscreen.svg") ) ) , tr("FullScreen"), this );
+    QAction* actionFullScreen = new QAction( tr("FullScreen"), this);
+    deferIcon(actionFullScreen, QStringLiteral("view-fullscreen") );
     actionFullScreen->setShortcuts(QKeySequence::FullScreen);
     actionFullScreen->setCheckable(true);
     connect(actionFullScreen, &QAction::triggered, this, &MainWindow::onFullscreen );
 
+    // THUMBNAILS
+    QAction* actionThumbnails = new QAction( tr("Thumbnails"), this);
+    deferIcon(actionThumbnails, QStringLiteral("view-preview") );
+    actionThumbnails->setShortcut(Qt::Key_F4);
+    actionThumbnails->setCheckable(true);
+    connect(actionThumbnails, &QAction::triggered, this, [=] (bool on) {
+            if (!on) {
+                _thumbnailBar->hide();
+                return;
+            }
+            thumbnailBar()->show();
+
+            // the dock can be closed by its own button too
+            connect(_thumbnailBar->toggleViewAction(), &QAction::toggled, actionThumbnails, &QAction::setChecked, Qt::UniqueConnection);
+        }
+    );
+
+    // COLORS
+    // the mode is a setting: every window follows it
+    QMenu* colorsMenu = new QMenu( tr("Colors"), this);
+    _colorModeActions = new QActionGroup(this);
+    _colorModeActions->setExclusive(true);
+    const QList<QPair<int, QString> > colorModes = QList<QPair<int, QString> >()
+        << qMakePair(int(ColorTransform::Normal), tr("Normal"))
+        << qMakePair(int(ColorTransform::Night), tr("Night"))
+        << qMakePair(int(ColorTransform::Sepia), tr("Sepia"))
+        << qMakePair(int(ColorTransform::Grayscale), tr("Grayscale"))
+        << qMakePair(int(ColorTransform::HighContrast), tr("High Contrast"));
+    for (const QPair<int, QString> &colorMode : colorModes) {
+        QAction* action = colorsMenu->addAction(colorMode.second);
+        action->setData(colorMode.first);
+        action->setCheckable(true);
+        action->setChecked( colorMode.first == _view->colorMode() );
+        _colorModeActions->addAction(action);
+    }
+    connect(_colorModeActions, &QActionGroup::triggered, this, [=] (QAction *action) {
+            Application::instance()->settings()->setValue( QStringLiteral("ColorMode"), action->data().toInt() );
+        }
+    );
+
     // find actions -----------------------------------------------------------------------------------------------------------
     // FIND
-    QAction* actionFind = new QAction( QIcon::fromTheme( QStringLiteral("edit-find") , QIcon( QStringLiteral(":/icons/edit-find.svg") ) ) , tr("Find"), this );
+    QAction* actionFind = new QAction( tr("Find"), this);
+    deferIcon(actionFind, QStringLiteral("edit-find") );
     actionFind->setShortcut(QKeySequence::Find);
     connect(actionFind, &QAction::triggered, this, &MainWindow::showSearchBar );
 
+    // FIND IN FOLDER
+    QAction* actionFindInFolder = new QAction( tr("Search in Folder"), this);
+    deferIcon(actionFindInFolder, QStringLiteral("system-search") );
+    actionFindInFolder->setShortcut( QKeySequence( QStringLiteral("Ctrl+Shift+F") ) );
+    connect(actionFindInFolder, &QAction::triggered, this, &MainWindow::showFolderSearchBar );
+
     // option actions ----------------------------------------------------------------------------------------------------------- 
     // SETTINGS
-    QAction* actionShowSettings = new QAction( QIcon::fromTheme( QStringLiteral("configure"), QIcon( QStringLiteral(":/icons/configure.svg") ) ) , tr("Settings"), this);
+    QAction* actionShowSettings = new QAction( tr("Settings"), this);
+    deferIcon(actionShowSettings, QStringLiteral("configure") );
     connect(actionShowSettings, &QAction::triggered, this, &MainWindow::showSettings);
 
     // about actions -----------------------------------------------------------------------------------------------------------    
     // ABOUT Qt
-    QAction* actionAboutQt = new QAction( QIcon::fromTheme( QStringLiteral("qt") , QIcon( QStringLiteral(":/icons/qt.svg") ) ) , tr("About Qt"), this );
+    QAction* actionAboutQt = new QAction( tr("About Qt"), this);
+    deferIcon(actionAboutQt, QStringLiteral("qt") );
     connect(actionAboutQt, &QAction::triggered, qApp, &QApplication::aboutQt);
 
     // ABOUT
-    QAction* actionAboutApp = new QAction( QIcon::fromTheme( QStringLiteral("help-about") , QIcon( QStringLiteral(":/icons/help-about.svg") ) ) , tr("About"), this );
+    QAction* actionAboutApp = new QAction( tr("About"), this);
+    deferIcon(actionAboutApp, QStringLiteral("help-about") );
     connect(actionAboutApp, &QAction::triggered, this, &MainWindow::about);
 
     // ------------------------------------------------------------------------------------------------------------------------
@@ -314,6 +976,7 @@ void MainWindow::setupActions()
     fileMenu->addMenu(menuRecentFiles);
     fileMenu->addAction(actionSave);
     fileMenu->addAction(actionSaveAs);
+    fileMenu->addAction(actionSavePages);
     fileMenu->addSeparator();
     fileMenu->addAction(actionPrint);
     fileMenu->addSeparator();
@@ -326,9 +989,13 @@ void MainWindow::setupActions()
     viewMenu->addAction(actionZoomOriginal);
     viewMenu->addSeparator();
     viewMenu->addAction(actionFullScreen);
+    viewMenu->addSeparator();
+    viewMenu->addAction(actionThumbnails);
+    viewMenu->addMenu(colorsMenu);
 
     QMenu* searchMenu = menuBar()->addMenu( tr("&Search") );
     searchMenu->addAction(actionFind);
+    searchMenu->addAction(actionFindInFolder);
 
     QMenu* optionsMenu = menuBar()->addMenu( tr("&Options") );
     optionsMenu->addAction(actionShowSettings);
@@ -368,6 +1035,8 @@ void MainWindow::setupActions()
 
 void MainWindow::setCurrentFilePath(const QString& path)
 {
+    const QString previousPath = _filePath;
+
     QString curFile;
     if (path.isEmpty()) {
         curFile = tr("untitled");
@@ -375,8 +1044,10 @@ void MainWindow::setCurrentFilePath(const QString& path)
     } else {
         curFile = QFileInfo(path).canonicalFilePath();
         _filePath = path;
-        addPathToRecentFiles(_filePath);
-//        Application::instance()->addWatchedPath(_filePath);
+    }
+
+    if (_filePath != previousPath) {
+        updateWatchedPath();
     }
 
     setWindowModified(false);
@@ -385,9 +1056,29 @@ void MainWindow::setCurrentFilePath(const QString& path)
 }
 
 
+void MainWindow::updateWatchedPath()
+{
+    // a file mapped by the document shown is never reloaded: it would
+    // read past the end of the file if it got shorter (SIGBUS).
+    // The one being loaded is copied, when files are reloaded
+    bool watch = _autoReload && !_filePath.isEmpty();
+    if (watch && (!_loader->isLoading() || _reloading)) {
+        watch = !DocumentLoader::isMemoryMapped(_document);
+    }
+
+    const QString path = watch ? _filePath : QString();
+    if (path == _watchedPath) {
+        return;
+    }
+    Application::instance()->removeWatchedPath(_watchedPath);
+    Application::instance()->addWatchedPath(path);
+    _watchedPath = path;
+}
+
+
 void MainWindow::newWindow()
 {
-//    Application::instance()->loadPath( QLatin1String("") );
+    Application::instance()->loadPath( QLatin1String("") );
 }
 
 
@@ -402,7 +1093,7 @@ void MainWindow::openFile()
         return;
     }
 
-//    Application::instance()->loadPath(path);
+    Application::instance()->loadPath(path);
 }
 
 
@@ -421,40 +1112,127 @@ void MainWindow::saveFileAs()
 {
     // needed to catch document dir location (and it has to be writable, obviously...)
     QString documentDir = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation);
-    QString path = QFileDialog::getSaveFileName(this, tr("Save File"), documentDir);
+    QString path = QFileDialog::getSaveFileName(this, tr("Save File"), documentDir, tr("PDF files (*.pdf)"));
     if (path.isEmpty())
         return;
 
-    // try to add .txt extension in the end
+    // try to add .pdf extension in the end
     QFileInfo info(path);
     if (info.fileName() == info.baseName()) {
-        path += QLatin1String(".txt");
+        path += QLatin1String(".pdf");
     }
 
     saveFilePath(path);
 }
 
 
+void MainWindow::savePages()
+{
+    const int pageCount = _document->pageCount();
+    if (pageCount == 0 || _fileSaver->isSaving()) {
+        return;
+    }
+
+    // the range, starting from the current page
+    QDialog dialog(this);
+    dialog.setWindowTitle( tr("Export Pages as Images") );
+
+    // the PDF library cannot write documents: pages are rendered
+    QLabel* note = new QLabel( tr("Pages are saved as %1 dpi images: their text cannot be selected "
+                                  "or searched, and they do not scale as the original ones.").arg(FileSaver::PAGE_DPI), &dialog);
+    note->setWordWrap(true);
+
+    QSpinBox* fromSpinBox = new QSpinBox(&dialog);
+    fromSpinBox->setRange(1, pageCount);
+    fromSpinBox->setValue(_view->currentPage() + 1);
+
+    QSpinBox* toSpinBox = new QSpinBox(&dialog);
+    toSpinBox->setRange(1, pageCount);
+    toSpinBox->setValue(pageCount);
+
+    QDialogButtonBox* buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, &dialog);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+
+    QFormLayout* layout = new QFormLayout(&dialog);
+    layout->addRow( tr("From page:"), fromSpinBox);
+    layout->addRow( tr("To page:"), toSpinBox);
+    layout->addRow(note);
+    layout->addRow(buttons);
+
+    if (dialog.exec() != QDialog::Accepted) {
+        return;
+    }
+    const int first = qMin(fromSpinBox->value(), toSpinBox->value()) - 1;
+    const int last = qMax(fromSpinBox->value(), toSpinBox->value()) - 1;
+
+    QString documentDir = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation);
+    QString path = QFileDialog::getSaveFileName(this, tr("Export Pages as Images"), documentDir, tr("PDF files (*.pdf)"));
+    if (path.isEmpty())
+        return;
+
+    QFileInfo info(path);
+    if (info.fileName() == info.baseName()) {
+        path += QLatin1String(".pdf");
+    }
+
+    saveProgressDialog( tr("Exporting pages %1-%2...").arg(first + 1).arg(last + 1) );
+    _fileSaver->savePages(_document, first, last, path);
+}
+
+
 void MainWindow::printFile()
 {
-    QPrinter printer;
-    QPrintDialog printDialog(&printer, this);
-    if (printDialog.exec() == QDialog::Accepted) {
-//        _textEdit->print(&printer);
+    const int pageCount = _document->pageCount();
+    if (_printJob || pageCount == 0) {
+        return;
+    }
+
+    QPrinter* printer = new QPrinter(QPrinter::HighResolution);
+    printer->setDocName( windowTitle() );
+
+    QPrintDialog printDialog(printer, this);
+    printDialog.setMinMax(1, pageCount);
+    if (printDialog.exec() != QDialog::Accepted) {
+        delete printer;
+        return;
     }
+
+    // pages are rendered and printed in background: the window keeps responding
+    _printJob = new PrintJob(_document, printer, this);
+    Application::instance()->memoryGovernor()->addConsumer(_printJob, MemoryGovernor::PrintPriority);
+
+    QProgressDialog* progress = new QProgressDialog(tr("Printing..."), tr("Cancel"), 0, _printJob->pageCount(), this);
+    progress->setWindowModality(Qt::WindowModal);
+    progress->setMinimumDuration(0);
+    progress->setAutoReset(false);
+
+    connect(_printJob, &PrintJob::progress, progress, &QProgressDialog::setValue);
+    connect(progress, &QProgressDialog::canceled, _printJob, &PrintJob::cancel);
+    connect(_printJob, &PrintJob::finished, this, [=] (bool completed) {
+            statusBar()->showMessage(completed ? tr("Document printed") : tr("Printing cancelled"), 5000);
+            progress->deleteLater();
+            _printJob->deleteLater();
+            _printJob = nullptr;
+        }
+    );
+
+    _printJob->start();
 }
 
 
 void MainWindow::onZoomIn()
 {
-    _zoomRange++;
+    _zoomRange = qMin(_zoomRange + 1, 10);
+    _view->setZoomFactor( qPow(1.25, _zoomRange) );
     updateStatusBar();
 }
 
 
 void MainWindow::onZoomOut()
 {
-    _zoomRange--;
+    _zoomRange = qMax(_zoomRange - 1, -6);
+    _view->setZoomFactor( qPow(1.25, _zoomRange) );
     updateStatusBar();
 }
 
@@ -462,6 +1240,7 @@ void MainWindow::onZoomOut()
 void MainWindow::onZoomOriginal()
 {
     _zoomRange = 0;
+    _view->setZoomFactor(1.0);
     updateStatusBar();
 }
 
@@ -498,6 +1277,19 @@ void MainWindow::about()
 
 void MainWindow::updateStatusBar()
 {
+    _statusBar->setPage(_view->currentPage(), _view->pageCount());
+    _statusBar->setZoom( QString::number( qRound(_view->zoomFactor() * 100) ) + QLatin1String("%") );
+}
+
+
+void MainWindow::updateDiagnostics()
+{
+    const RenderCache* cache = Application::instance()->renderCache();
+    _statusBar->setDiagnostics(cache->lastRenderTime(),
+                               cache->hitRate(),
+                               cache->bytesUsed(),
+                               cache->pendingRenders(),
+                               MemoryGovernor::residentSetSize());
 }
 
 
@@ -506,49 +1298,105 @@ void MainWindow::showSettings()
     SettingsDialog* dialog = new SettingsDialog(this);
     dialog->exec();
     dialog->deleteLater();
-
-//    Application::instance()->loadSettings();
 }
 
 
 void MainWindow::showSearchBar()
 {
-    if (_searchBar->isVisible()) {
+    if (_searchBar && _searchBar->isVisible()) {
         _searchBar->hide();
+        _searchEngine->stopSearch();
         return;
     }
 
-    _searchBar->show();
+    searchBar()->show();
 
     _searchBar->setFocus();
 }
 
 
-void MainWindow::search(const QString & search, bool forward, bool casesensitive)
+void MainWindow::showFolderSearchBar()
+{
+    FolderSearchBar* bar = folderSearchBar();
+
+    // the folder of the file shown, unless another one was searched
+    if (!_filePath.isEmpty()) {
+        bar->setDirectory( QFileInfo(_filePath).absolutePath() );
+    }
+
+    bar->show();
+    bar->raise();
+    bar->setFocus();
+}
+
+
+void MainWindow::search(const QString & search, bool forward, SearchEngine::SearchFlags flags)
 {
+    _searchEngine->find(search, _view->currentPage(), forward, flags);
 }
 
 
-void MainWindow::addPathToRecentFiles(const QString& path)
+void MainWindow::recordHistory()
 {
-    QSettings s;
-    QStringList recentFiles = s.value( QStringLiteral("recentFiles") ).toStringList();
-    recentFiles.removeOne(path);
-    recentFiles.prepend(path);
-    if (recentFiles.count() > 10) {
-        recentFiles.removeLast();
+    if (_filePath.isEmpty() || _document->pageCount() == 0) {
+        return;
+    }
+
+    HistoryStore* history = Application::instance()->historyStore();
+    const QFileInfo info(_filePath);
+    HistoryEntry entry = history->entry(_filePath);
+
+    // nothing new to write
+    const bool sameFile = !entry.path.isEmpty() && entry.matches(info);
+    if (sameFile && entry.lastPage == _view->currentPage() && qFuzzyCompare(entry.zoom, _view->zoomFactor())
+        && !entry.thumbnail.isNull() && history->entries().first().path == _filePath) {
+        return;
     }
-    s.setValue( QStringLiteral("recentFiles") , recentFiles);
+
+    if (!sameFile) {
+        entry.thumbnail = QImage();
+    }
+    if (entry.thumbnail.isNull()) {
+        entry.thumbnail = historyThumbnail();
+    }
+
+    entry.path = _filePath;
+    entry.size = info.size();
+    entry.modified = info.lastModified();
+    entry.lastPage = _view->currentPage();
+    entry.zoom = _view->zoomFactor();
+    entry.pageCount = _document->pageCount();
+    history->update(entry);
+}
+
+
+QImage MainWindow::historyThumbnail()
+{
+    // the first page thumbnail, as the thumbnail bar renders it
+    RenderCache* cache = Application::instance()->renderCache();
+    const RenderKey key = ThumbnailModel::thumbnailKey(_document, 0, devicePixelRatioF());
+    const QImage image = cache->image(key);
+    if (image.isNull()) {
+        // ready for the next time
+        const QSize size = ThumbnailModel::thumbnailSize(_document->pageSize(0), devicePixelRatioF());
+        cache->request(key, size, RenderCache::ThumbnailPriority);
+        return QImage();
+    }
+
+    const qreal ratio = devicePixelRatioF();
+    QImage thumbnail = image.scaled(QSize(48, 48) * ratio, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    thumbnail.setDevicePixelRatio(ratio);
+    return thumbnail;
 }
 
 
 void MainWindow::recentFileTriggered()
 {
     QAction* a = qobject_cast<QAction* >(sender());
-    QString path = a->text();
+    QString path = a->data().toString();
     if (_filePath.isEmpty()) {
         loadFilePath(path);
         return;
     }
-//    Application::instance()->loadPath(path);
+    Application::instance()->loadPath(path);
 }
@@ -11,16 +11,32 @@
 #define MAINWINDOW_H
 
 
+#include <QHash>
 #include <QMainWindow>
+#include <QPair>
+#include <QVector>
 
+#include "searchengine.h"
+
+class QAction;
+class QActionGroup;
 class QCloseEvent;
 class QKeyEvent;
+class QProgressDialog;
+class QShowEvent;
+class QTimer;
 
 class QPdfDocument;
-class QPdfView;
 
+class DocumentLoader;
+class FileSaver;
+class FolderSearchBar;
+class PageMatcher;
+class PageView;
+class PrintJob;
 class SearchBar;
 class StatusBar;
+class ThumbnailBar;
 
 
 class MainWindow : public QMainWindow
@@ -29,18 +45,20 @@ class MainWindow : public QMainWindow
 
 public:
     explicit MainWindow(QWidget *parent = nullptr);
+    ~MainWindow();
 
     inline QString filePath() const { return _filePath; }
 
-    void loadSettings();
-
     // needed to position next windows
     void tile(const QMainWindow *previous);
 
     // public functions to load and save the actual file
     // from the outside
-    void loadFilePath(const QString &path);
+    void loadFilePath(const QString &path, int page = -1);
     void saveFilePath(const QString &path);
+
+    // goes to page, once the document is loaded
+    void showPage(int page);
     
     // ask user to save or not, eventually blocking exit action
     // returns true if window has to be closed, false otherwise
@@ -48,20 +66,36 @@ public:
 
 
 protected:
+    void showEvent(QShowEvent *event) override;
     void closeEvent(QCloseEvent *event) override;
     void keyPressEvent(QKeyEvent *event) override;
 
 private:
+    void loadSettings();
     void setupActions();
+    void deferIcon(QAction *action, const QString &iconName);
+
+    SearchBar* searchBar();
+    ThumbnailBar* thumbnailBar();
+    FolderSearchBar* folderSearchBar();
 
     void setCurrentFilePath(const QString& path);
-    void addPathToRecentFiles(const QString& path);
+    void setDocument(QPdfDocument *document, bool keepPosition = false);
+    void showDocument(QPdfDocument *document, const QString &title);
+    void dropPendingDocument();
+    // remembers the file and where it was left
+    void recordHistory();
+    QImage historyThumbnail();
+
+    // shows the progress of the save being started
+    QProgressDialog* saveProgressDialog(const QString &label);
 
 private Q_SLOTS:
     void newWindow();
     void openFile();
     void saveFile();
     void saveFileAs();
+    void savePages();
     void printFile();
 
     void onZoomIn();
@@ -70,31 +104,83 @@ private Q_SLOTS:
     void onFullscreen(bool on);
 
     void showSettings();
+    // updates only what depends on keys
+    void applySettings(const QStringList &keys);
 
     void about();
 
     void updateStatusBar();
+    void updateDiagnostics();
 
     void showSearchBar();
+    void showFolderSearchBar();
+
+    void loadDeferredIcons();
 
     void search(const QString & search,
-                bool forward = true,
-                bool casesensitive = false);
+                bool forward,
+                SearchEngine::SearchFlags flags);
 
     void recentFileTriggered();
+    void restoreFromHistory();
+
+    void onDocumentLoaded(QPdfDocument *document, const QString &title);
+    void onDocumentLoadFailed(const QString &path, const QString &error);
+    void onContentHashReady(QPdfDocument *document, const QByteArray &hash);
+
+    // from the documents shared with the other windows
+    void applyContentHash(QPdfDocument *document, const QByteArray &hash);
+    void onDocumentReplaced(QPdfDocument *from, QPdfDocument *to);
+
+    // the file changed on disk
+    void onWatchedFileChanged(const QString &path);
+    void reloadDocument();
+    void updateWatchedPath();
+    void onPagesMatched(QPdfDocument *document, const QHash<int, int> &unchangedPages);
 
 Q_SIGNALS:
     void searchMessage(const QString &);
 
 private:
-    QPdfView* _view;
+    PageView* _view;
     QPdfDocument* _document;
-    
+    DocumentLoader* _loader;
+    FileSaver* _fileSaver;
+
     SearchBar* _searchBar;
+    SearchEngine* _searchEngine;
     StatusBar* _statusBar;
+    ThumbnailBar* _thumbnailBar;
+    FolderSearchBar* _folderSearchBar;
+    PrintJob* _printJob;
+    QTimer* _diagnosticsTimer;
+
+    // one for each color mode, the current one checked
+    QActionGroup* _colorModeActions;
+
+    QVector<QPair<QAction*, QString> > _deferredIcons;
 
     QString _filePath;
+    QByteArray _contentHash;
+
+    // a new version of the file is loaded and compared with the one shown,
+    // that stays until the pages that did not change are known
+    PageMatcher* _pageMatcher;
+    QTimer* _reloadTimer;
+    bool _reloading;
+    bool _autoReload;
+    // the file watched, if any: not mapped by the document shown
+    QString _watchedPath;
+    QPdfDocument* _pendingDocument;
+    QString _pendingTitle;
+    QByteArray _pendingContentHash;
+
+    // the recent files menu is built again only after the history changed
+    bool _recentFilesDirty;
     int _zoomRange;
+
+    // shown once loaded, instead of the page the file was left at
+    int _startPage;
     bool _canBeReloaded;
 };
 
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "mappedfile.h"
+
+#include <climits>
+
+
+MappedFile::MappedFile(const QString &path, QObject *parent)
+    : QBuffer(parent)
+    , _file(path)
+{
+}
+
+
+MappedFile::~MappedFile()
+{
+    // the buffer points into the mapping, that goes away with _file
+    close();
+    setData(QByteArray());
+}
+
+
+bool MappedFile::map()
+{
+    if (!_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // QByteArray cannot wrap more than INT_MAX bytes
+    const qint64 size = _file.size();
+    if (size <= 0 || size > INT_MAX) {
+        _file.close();
+        return false;
+    }
+
+    uchar* data = _file.map(0, size);
+    if (!data) {
+        _file.close();
+        return false;
+    }
+
+    // no copy: the byte array just wraps the mapping
+    setData( QByteArray::fromRawData(reinterpret_cast<const char*>(data), int(size)) );
+    return open(QIODevice::ReadOnly);
+}
+
+
+bool MappedFile::copy()
+{
+    if (!_file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    const qint64 size = _file.size();
+    if (size <= 0 || size > INT_MAX) {
+        _file.close();
+        return false;
+    }
+
+    // a file being written may not have the size it had a moment ago
+    const QByteArray data = _file.readAll();
+    _file.close();
+    if (data.isEmpty()) {
+        return false;
+    }
+
+    setData(data);
+    return open(QIODevice::ReadOnly);
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+
+#include <QBuffer>
+#include <QFile>
+
+
+// A read-only device over a memory mapped file.
+// Nothing is read in advance: the file pages are faulted in when the
+// document asks for them, and shared with the system page cache.
+// Files that may be rewritten while they are read are copied instead:
+// reading a mapping past the end of a file truncated meanwhile kills
+// the process (SIGBUS).
+class MappedFile : public QBuffer
+{
+    Q_OBJECT
+
+public:
+    explicit MappedFile(const QString &path, QObject *parent = nullptr);
+    ~MappedFile();
+
+    // maps the file and opens the device, returns false on failure
+    bool map();
+
+    // reads the whole file and opens the device, returns false on failure:
+    // later changes of the file are not seen
+    bool copy();
+
+    inline bool isMapped() const { return _file.isOpen(); }
+
+private:
+    QFile _file;
+};
+
+#endif // MAPPEDFILE_H
@@ -0,0 +1,267 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "memorygovernor.h"
+
+#include "tracing.h"
+
+#include <QFile>
+#include <QTimer>
+
+#ifdef Q_OS_LINUX
+#include <unistd.h>
+#endif
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+
+// how often the resident memory is checked, in ms: more often when near the limit
+static const int CHECK_INTERVAL = 1000;
+static const int PRESSURE_CHECK_INTERVAL = 250;
+
+
+MemoryConsumer::MemoryConsumer()
+    : _governor(nullptr)
+{
+}
+
+
+MemoryConsumer::~MemoryConsumer()
+{
+    if (_governor) {
+        _governor->removeConsumer(this);
+    }
+}
+
+
+MemoryGovernor::MemoryGovernor(QObject *parent)
+    : QObject(parent)
+    , _budget(0)
+    , _cgroupLimit( cgroupLimit() )
+    , _limit(0)
+    , _residentSize(0)
+    , _buffers(0)
+    , _checkQueued(0)
+    , _timer(new QTimer(this))
+{
+    updateLimit();
+
+    _timer->setInterval(CHECK_INTERVAL);
+    connect(_timer, &QTimer::timeout, this, &MemoryGovernor::check);
+}
+
+
+MemoryGovernor::~MemoryGovernor()
+{
+    for (const auto &consumer : qAsConst(_consumers)) {
+        consumer.second->_governor = nullptr;
+    }
+}
+
+
+void MemoryGovernor::setBudget(qint64 bytes)
+{
+    _budget = qMax(qint64(0), bytes);
+    updateLimit();
+}
+
+
+void MemoryGovernor::updateLimit()
+{
+    qint64 limit = _cgroupLimit;
+    if (_budget > 0 && (limit == 0 || _budget < limit)) {
+        limit = _budget;
+    }
+    _limit.storeRelaxed(limit);
+
+    // nothing to watch without a limit
+    if (limit > 0) {
+        _timer->start();
+        check();
+    } else {
+        _timer->stop();
+    }
+}
+
+
+void MemoryGovernor::addConsumer(MemoryConsumer *consumer, int priority)
+{
+    if (consumer->_governor) {
+        consumer->_governor->removeConsumer(consumer);
+    }
+    consumer->_governor = this;
+
+    int i = 0;
+    while (i < _consumers.count() && _consumers.at(i).first <= priority) {
+        ++i;
+    }
+    _consumers.insert(i, qMakePair(priority, consumer));
+}
+
+
+void MemoryGovernor::removeConsumer(MemoryConsumer *consumer)
+{
+    for (int i = 0; i < _consumers.count(); ++i) {
+        if (_consumers.at(i).second == consumer) {
+            _consumers.remove(i);
+            break;
+        }
+    }
+    consumer->_governor = nullptr;
+}
+
+
+qint64 MemoryGovernor::memoryUsed() const
+{
+    qint64 used = 0;
+    for (const auto &consumer : _consumers) {
+        used += consumer.second->memoryUsed();
+    }
+    return used;
+}
+
+
+void MemoryGovernor::acquireBuffer(qint64 bytes)
+{
+    QMutexLocker locker(&_buffersMutex);
+
+    const qint64 limit = _limit.loadRelaxed();
+    while (limit > 0 && _buffers > 0
+           && _residentSize.loadRelaxed() + bytes > limit / 100 * HIGH_WATERMARK) {
+        // the GUI thread makes room, meanwhile
+        if (_checkQueued.testAndSetOrdered(0, 1)) {
+            MemoryGovernor* governor = this;
+            QMetaObject::invokeMethod(governor, [=] () {
+                    governor->check();
+                }, Qt::QueuedConnection
+            );
+        }
+        _buffersReleased.wait(&_buffersMutex, PRESSURE_CHECK_INTERVAL);
+    }
+    _buffers += bytes;
+}
+
+
+void MemoryGovernor::releaseBuffer(qint64 bytes)
+{
+    QMutexLocker locker(&_buffersMutex);
+    _buffers -= bytes;
+    _buffersReleased.wakeAll();
+}
+
+
+void MemoryGovernor::check()
+{
+    _checkQueued.storeRelaxed(0);
+
+    const qint64 limit = _limit.loadRelaxed();
+    qint64 resident = residentSetSize();
+    if (limit <= 0 || resident < 0) {
+        return;
+    }
+
+    if (resident > limit / 100 * HIGH_WATERMARK) {
+        TRACE_SCOPE("memory", "trim memory");
+
+        qint64 excess = resident - limit / 100 * LOW_WATERMARK;
+        for (const auto &consumer : qAsConst(_consumers)) {
+            excess -= consumer.second->trimMemory(excess);
+            if (excess <= 0) {
+                break;
+            }
+        }
+
+#ifdef __GLIBC__
+        // the small blocks freed go back to the system too
+        malloc_trim(0);
+#endif
+
+        resident = residentSetSize();
+    }
+
+    _residentSize.storeRelaxed(resident);
+
+    // renders waiting for room try again
+    _buffersReleased.wakeAll();
+
+    const bool pressure = resident > limit / 100 * LOW_WATERMARK;
+    _timer->setInterval(pressure ? PRESSURE_CHECK_INTERVAL : CHECK_INTERVAL);
+}
+
+
+#ifdef Q_OS_LINUX
+// the first number in path, 0 if there is none (as for "max")
+static qint64 readLimit(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+    bool ok = false;
+    const qint64 value = file.readLine().trimmed().toLongLong(&ok);
+    return ok ? value : 0;
+}
+#endif
+
+
+qint64 MemoryGovernor::cgroupLimit()
+{
+#ifdef Q_OS_LINUX
+    // cgroup v2: the group of the process is in its "0::" line
+    QString group;
+    QFile cgroup( QStringLiteral("/proc/self/cgroup") );
+    if (cgroup.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> lines = cgroup.readAll().split('\n');
+        for (const QByteArray &line : lines) {
+            if (line.startsWith("0::")) {
+                group = QString::fromLocal8Bit( line.mid(3) );
+                break;
+            }
+        }
+    }
+
+    qint64 limit = 0;
+    if (!group.isEmpty()) {
+        limit = readLimit( QStringLiteral("/sys/fs/cgroup") + group + QStringLiteral("/memory.max") );
+    }
+    // in a container the group is mounted as the root
+    if (limit == 0) {
+        limit = readLimit( QStringLiteral("/sys/fs/cgroup/memory.max") );
+    }
+
+    // cgroup v1: no limit is a huge number
+    if (limit == 0) {
+        limit = readLimit( QStringLiteral("/sys/fs/cgroup/memory/memory.limit_in_bytes") );
+        if (limit >= (Q_INT64_C(1) << 60)) {
+            limit = 0;
+        }
+    }
+    return limit;
+#else
+    return 0;
+#endif
+}
+
+
+qint64 MemoryGovernor::residentSetSize()
+{
+#ifdef Q_OS_LINUX
+    // the second field of statm is the resident size, in pages
+    QFile statm( QStringLiteral("/proc/self/statm") );
+    if (statm.open(QIODevice::ReadOnly)) {
+        const QList<QByteArray> fields = statm.readAll().split(' ');
+        if (fields.count() > 1) {
+            return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+        }
+    }
+#endif
+    return -1;
+}
@@ -0,0 +1,123 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef MEMORYGOVERNOR_H
+#define MEMORYGOVERNOR_H
+
+
+#include <QAtomicInteger>
+#include <QMutex>
+#include <QObject>
+#include <QPair>
+#include <QVector>
+#include <QWaitCondition>
+
+class QTimer;
+
+class MemoryGovernor;
+
+
+// Something holding memory that can give (some of) it back.
+// Consumers unregister themselves from their governor when deleted.
+class MemoryConsumer
+{
+public:
+    MemoryConsumer();
+    virtual ~MemoryConsumer();
+
+    // bytes held now
+    virtual qint64 memoryUsed() const = 0;
+
+    // frees about bytes, or what can be freed: returns the bytes freed
+    virtual qint64 trimMemory(qint64 bytes) = 0;
+
+private:
+    friend class MemoryGovernor;
+    MemoryGovernor* _governor;
+};
+
+
+// Keeps the process under a memory limit: the one of its cgroup (as in a
+// container), or a configured budget, whichever is lower.
+// The resident memory is checked at a regular pace: when it gets near the
+// limit, the consumers are trimmed in priority order until it is well
+// below it, so that pages are rendered again instead of the process being
+// killed. Render buffers are accounted before being allocated: under
+// pressure, renders wait for the ones running, instead of piling up.
+class MemoryGovernor : public QObject
+{
+    Q_OBJECT
+
+public:
+    // lowest trimmed first
+    enum Priority {
+        ThumbnailPriority = 0,
+        RenderCachePriority = 10,
+        PrintPriority = 20
+    };
+
+    // trimming starts over HIGH_WATERMARK and goes down to LOW_WATERMARK
+    // (percent of the limit)
+    static const int HIGH_WATERMARK = 85;
+    static const int LOW_WATERMARK = 70;
+
+    explicit MemoryGovernor(QObject *parent = nullptr);
+    ~MemoryGovernor();
+
+    // the configured budget, 0 for the cgroup limit only
+    void setBudget(qint64 bytes);
+    inline qint64 budget() const { return _budget; }
+
+    // the limit enforced, 0 for none
+    inline qint64 limit() const { return _limit.loadRelaxed(); }
+
+    void addConsumer(MemoryConsumer *consumer, int priority);
+    void removeConsumer(MemoryConsumer *consumer);
+
+    // the memory held by all the consumers
+    qint64 memoryUsed() const;
+
+    // thread safe: waits while bytes more would go over the limit,
+    // unless no other buffer is accounted
+    void acquireBuffer(qint64 bytes);
+    void releaseBuffer(qint64 bytes);
+
+    // the memory limit of the cgroup of the process (0 if none)
+    static qint64 cgroupLimit();
+
+    // resident memory of the process, in bytes (-1 if unknown)
+    static qint64 residentSetSize();
+
+public Q_SLOTS:
+    // trims the consumers, if the process is near the limit
+    void check();
+
+private:
+    void updateLimit();
+
+private:
+    // sorted by priority
+    QVector<QPair<int, MemoryConsumer*> > _consumers;
+
+    qint64 _budget;
+    qint64 _cgroupLimit;
+    QAtomicInteger<qint64> _limit;
+
+    // the last resident size read
+    QAtomicInteger<qint64> _residentSize;
+
+    QMutex _buffersMutex;
+    QWaitCondition _buffersReleased;
+    qint64 _buffers;
+    QAtomicInt _checkQueued;
+
+    QTimer* _timer;
+};
+
+#endif // MEMORYGOVERNOR_H
@@ -0,0 +1,187 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "pagematcher.h"
+
+#include "documentregistry.h"
+#include "rendercache.h"
+#include "tracing.h"
+
+#include <QtConcurrent>
+
+#include <QCryptographicHash>
+#include <QPdfDocument>
+
+
+static QByteArray pageFingerprint(QPdfDocument *document, int page)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+
+    const QSizeF size = document->pageSize(page);
+    hash.addData( QByteArray::number(size.width()) );
+    hash.addData( QByteArray::number(size.height()) );
+    hash.addData( document->getAllText(page).text().toUtf8() );
+
+    // what is not text: pictures, drawings, colors. Page sizes are in points
+    if (size.width() > 0 && size.height() > 0) {
+        QSizeF probeSize = size * PageMatcher::PROBE_DPI / 72.0;
+        if (qMax(probeSize.width(), probeSize.height()) > PageMatcher::MAX_PROBE_SIZE) {
+            probeSize.scale(PageMatcher::MAX_PROBE_SIZE, PageMatcher::MAX_PROBE_SIZE, Qt::KeepAspectRatio);
+        }
+        const QImage probe = RenderCache::renderPage(document, page, probeSize.toSize().expandedTo( QSize(1, 1) ));
+        hash.addData( reinterpret_cast<const char*>(probe.constBits()), int(probe.sizeInBytes()) );
+    }
+
+    return hash.result();
+}
+
+
+static PageFingerprints takeFingerprints(QPdfDocument *document, QSharedPointer<QAtomicInt> cancelled)
+{
+    return PageMatcher::fingerprints(document, cancelled.data());
+}
+
+
+PageMatcher::PageMatcher(DocumentRegistry *registry, QObject *parent)
+    : QObject(parent)
+    , _registry(registry)
+    , _document(nullptr)
+    , _next(nullptr)
+    , _watcher(nullptr)
+{
+    _pool.setMaxThreadCount(1);
+
+    connect(_registry, &DocumentRegistry::fingerprintsReady, this, [=] (QPdfDocument *document) {
+            if (document == _document) {
+                compare();
+            }
+        }
+    );
+}
+
+
+PageMatcher::~PageMatcher()
+{
+    cancel();
+}
+
+
+PageFingerprints PageMatcher::fingerprints(QPdfDocument *document, const QAtomicInt *cancelled)
+{
+    TRACE_SCOPE("reload", "page fingerprints");
+
+    PageFingerprints fingerprints;
+    const int pageCount = document->pageCount();
+    fingerprints.reserve(pageCount);
+    for (int page = 0; page < pageCount; ++page) {
+        if (cancelled->loadAcquire()) {
+            return PageFingerprints();
+        }
+        fingerprints.append( pageFingerprint(document, page) );
+    }
+    return fingerprints;
+}
+
+
+void PageMatcher::setDocument(QPdfDocument *document)
+{
+    // the new version just matched: its fingerprints are known already
+    if (document && document == _next && !_watcher) {
+        _registry->setFingerprints(document, _nextFingerprints);
+    }
+
+    cancelMatch();
+    _document = document;
+}
+
+
+void PageMatcher::prepare()
+{
+    if (_document) {
+        _registry->takeFingerprints(_document);
+    }
+}
+
+
+void PageMatcher::match(QPdfDocument *document)
+{
+    cancelMatch();
+    prepare();
+
+    _next = document;
+    _cancelled.reset(new QAtomicInt(0));
+
+    _watcher = new QFutureWatcher<PageFingerprints>(this);
+    connect(_watcher, &QFutureWatcherBase::finished, this, &PageMatcher::onFingerprintsReady);
+    _watcher->setFuture( QtConcurrent::run(&_pool, takeFingerprints, document, _cancelled) );
+}
+
+
+void PageMatcher::cancelMatch()
+{
+    if (_watcher) {
+        // the worker stops at the next page
+        _cancelled->storeRelease(1);
+        _watcher->disconnect(this);
+        _watcher->waitForFinished();
+        delete _watcher;
+        _watcher = nullptr;
+    }
+    _next = nullptr;
+    _nextFingerprints.clear();
+}
+
+
+void PageMatcher::cancel()
+{
+    cancelMatch();
+}
+
+
+void PageMatcher::onFingerprintsReady()
+{
+    _nextFingerprints = _watcher->result();
+    _watcher->deleteLater();
+    _watcher = nullptr;
+
+    compare();
+}
+
+
+void PageMatcher::compare()
+{
+    if (!_next || _watcher || !_registry->hasFingerprints(_document)) {
+        return;
+    }
+
+    const PageFingerprints current = _registry->fingerprints(_document);
+
+    // the first page with each fingerprint
+    QHash<QByteArray, int> previousPages;
+    for (int page = current.count() - 1; page >= 0; --page) {
+        previousPages.insert(current.at(page), page);
+    }
+
+    // pages are mostly found where they were, or a few places
+    // away when some were added or removed before them
+    QHash<int, int> unchangedPages;
+    for (int page = 0; page < _nextFingerprints.count(); ++page) {
+        const QByteArray &fingerprint = _nextFingerprints.at(page);
+        if (page < current.count() && current.at(page) == fingerprint) {
+            unchangedPages.insert(page, page);
+            continue;
+        }
+        const auto it = previousPages.constFind(fingerprint);
+        if (it != previousPages.constEnd()) {
+            unchangedPages.insert(page, it.value());
+        }
+    }
+
+    Q_EMIT matched(_next, unchangedPages);
+}
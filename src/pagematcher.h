@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef PAGEMATCHER_H
+#define PAGEMATCHER_H
+
+
+#include <QAtomicInt>
+#include <QByteArray>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QObject>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVector>
+
+class QPdfDocument;
+
+class DocumentRegistry;
+
+typedef QVector<QByteArray> PageFingerprints;
+
+
+// Tells which pages of a new version of a document did not change.
+// Every page has a fingerprint: a hash of its size, its text and a render
+// of it at the resolution of a 100% zoom, where a change the size of a
+// line of text (a figure regenerated, a plot point moved) shows.
+// The fingerprints of the document shown are taken by the document
+// registry, once for all the windows showing it, as soon as its file
+// changes (the document keeps the bytes it was loaded from); the ones of
+// a new version when it is matched.
+class PageMatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    // the resolution of the render taken for the fingerprints, in dpi,
+    // and its largest side for huge pages, in pixels
+    static const int PROBE_DPI = 96;
+    static const int MAX_PROBE_SIZE = 4096;
+
+    explicit PageMatcher(DocumentRegistry *registry, QObject *parent = nullptr);
+
+    // cancels everything, waiting for the worker
+    ~PageMatcher();
+
+    // the fingerprints of every page of document, empty if cancelled
+    static PageFingerprints fingerprints(QPdfDocument *document, const QAtomicInt *cancelled);
+
+    // the document shown, nullptr for none
+    void setDocument(QPdfDocument *document);
+
+    // the file of the document shown changed: its fingerprints are
+    // taken while the new version is being written
+    void prepare();
+
+    // compares document, a new version of the one shown, with it:
+    // a previous match still running is dropped
+    void match(QPdfDocument *document);
+
+    // drops the match running: the document being matched can be deleted
+    void cancelMatch();
+
+    // waits for the worker: after it the documents can be deleted
+    void cancel();
+
+Q_SIGNALS:
+    // page of document -> page of the previous version, for every page
+    // that did not change (none, if the previous one is not known)
+    void matched(QPdfDocument *document, const QHash<int, int> &unchangedPages);
+
+private Q_SLOTS:
+    void onFingerprintsReady();
+
+private:
+    void compare();
+
+private:
+    DocumentRegistry* _registry;
+
+    // the PDF library works one call at a time anyway
+    QThreadPool _pool;
+
+    QPdfDocument* _document;
+
+    // the new version being matched
+    QPdfDocument* _next;
+    PageFingerprints _nextFingerprints;
+    QFutureWatcher<PageFingerprints>* _watcher;
+    QSharedPointer<QAtomicInt> _cancelled;
+};
+
+#endif // PAGEMATCHER_H
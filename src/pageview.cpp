@@ -0,0 +1,343 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "pageview.h"
+
+#include "colortransform.h"
+#include "rendercache.h"
+
+#include <QPainter>
+#include <QPaintEvent>
+#include <QScrollBar>
+
+#include <QPdfDocument>
+
+#include <algorithm>
+
+
+// margin around the document and space between pages
+static const int DOCUMENT_MARGIN = 6;
+static const int PAGE_SPACING = 3;
+
+
+PageView::PageView(RenderCache *cache, QWidget *parent)
+    : QAbstractScrollArea(parent)
+    , _cache(cache)
+    , _document(nullptr)
+    , _zoomFactor(1.0)
+    , _colorMode(ColorTransform::Normal)
+    , _blankColor(Qt::white)
+    , _currentPage(0)
+    , _pagePainted(false)
+{
+    viewport()->setBackgroundRole(QPalette::Dark);
+    viewport()->setAutoFillBackground(true);
+
+    verticalScrollBar()->setSingleStep(20);
+    horizontalScrollBar()->setSingleStep(20);
+
+    connect(_cache, &RenderCache::pageRendered, this, &PageView::onPageRendered);
+}
+
+
+void PageView::setDocument(QPdfDocument *document, bool keepPosition)
+{
+    // the page on top of the viewport, and how much of it is scrolled away
+    const int anchorPage = keepPosition ? firstVisiblePage() : -1;
+    const int anchorOffset = anchorPage >= 0 ? verticalScrollBar()->value() - _pageGeometries.at(anchorPage).top() : 0;
+    const int x = horizontalScrollBar()->value();
+
+    _document = document;
+    _currentPage = 0;
+
+    _pageSizes.clear();
+    const int pageCount = _document ? _document->pageCount() : 0;
+    _pageSizes.reserve(pageCount);
+    for (int page = 0; page < pageCount; ++page) {
+        _pageSizes.append( _document->pageSize(page) );
+    }
+
+    updateLayout();
+    if (anchorPage >= 0 && anchorPage < _pageGeometries.count()) {
+        verticalScrollBar()->setValue(_pageGeometries.at(anchorPage).top() + anchorOffset);
+        horizontalScrollBar()->setValue(x);
+    } else {
+        verticalScrollBar()->setValue(0);
+        horizontalScrollBar()->setValue(0);
+    }
+    updateCurrentPage();
+
+    viewport()->update();
+    Q_EMIT documentChanged();
+    Q_EMIT currentPageChanged(_currentPage);
+}
+
+
+void PageView::setZoomFactor(qreal factor)
+{
+    if (qFuzzyCompare(factor, _zoomFactor)) {
+        return;
+    }
+
+    // keep the same point of the document on top of the viewport
+    const qreal ratio = factor / _zoomFactor;
+    const int y = verticalScrollBar()->value();
+
+    _zoomFactor = factor;
+    updateLayout();
+
+    verticalScrollBar()->setValue( qRound(y * ratio) );
+    viewport()->update();
+
+    Q_EMIT zoomFactorChanged(_zoomFactor);
+}
+
+
+void PageView::setColorMode(int mode)
+{
+    if (mode == _colorMode) {
+        return;
+    }
+    _colorMode = mode;
+
+    // the blank page, in the same colors of the rendered ones
+    QImage blank(1, 1, QImage::Format_ARGB32_Premultiplied);
+    blank.fill(Qt::white);
+    ColorTransform::apply( blank, ColorTransform::mode(mode) );
+    _blankColor = blank.pixelColor(0, 0);
+
+    viewport()->update();
+}
+
+
+void PageView::setCurrentPage(int page)
+{
+    if (page < 0 || page >= _pageGeometries.count()) {
+        return;
+    }
+
+    verticalScrollBar()->setValue(_pageGeometries.at(page).top() - DOCUMENT_MARGIN);
+    updateCurrentPage();
+}
+
+
+int PageView::firstVisiblePage() const
+{
+    const int top = verticalScrollBar()->value();
+    const auto it = std::lower_bound(_pageGeometries.constBegin(), _pageGeometries.constEnd(), top,
+                                     [] (const QRect &r, int y) { return r.bottom() < y; });
+    if (it == _pageGeometries.constEnd()) {
+        return -1;
+    }
+    return int(it - _pageGeometries.constBegin());
+}
+
+
+int PageView::lastVisiblePage() const
+{
+    const int bottom = verticalScrollBar()->value() + viewport()->height();
+    const auto it = std::lower_bound(_pageGeometries.constBegin(), _pageGeometries.constEnd(), bottom,
+                                     [] (const QRect &r, int y) { return r.top() < y; });
+    return int(it - _pageGeometries.constBegin()) - 1;
+}
+
+
+void PageView::updateLayout()
+{
+    _pageGeometries.clear();
+
+    // page sizes are in points
+    const qreal scale = _zoomFactor * logicalDpiY() / 72.0;
+
+    int maxWidth = 0;
+    QVector<QSize> sizes;
+    sizes.reserve(_pageSizes.count());
+    for (const QSizeF &pageSize : qAsConst(_pageSizes)) {
+        const QSize size = (pageSize * scale).toSize();
+        maxWidth = qMax(maxWidth, size.width());
+        sizes.append(size);
+    }
+
+    const int width = maxWidth + 2 * DOCUMENT_MARGIN;
+    int y = DOCUMENT_MARGIN;
+    for (const QSize &size : qAsConst(sizes)) {
+        const int x = (qMax(width, viewport()->width()) - size.width()) / 2;
+        _pageGeometries.append( QRect(QPoint(x, y), size) );
+        y += size.height() + PAGE_SPACING;
+    }
+
+    _documentSize = QSize(width, y - PAGE_SPACING + DOCUMENT_MARGIN);
+    updateScrollBars();
+}
+
+
+void PageView::updateScrollBars()
+{
+    const QSize viewportSize = viewport()->size();
+
+    horizontalScrollBar()->setRange(0, qMax(0, _documentSize.width() - viewportSize.width()));
+    horizontalScrollBar()->setPageStep(viewportSize.width());
+
+    verticalScrollBar()->setRange(0, qMax(0, _documentSize.height() - viewportSize.height()));
+    verticalScrollBar()->setPageStep(viewportSize.height());
+}
+
+
+void PageView::updateCurrentPage()
+{
+    // the current page is the one in the middle of the viewport
+    const int middle = verticalScrollBar()->value() + viewport()->height() / 2;
+    const auto it = std::lower_bound(_pageGeometries.constBegin(), _pageGeometries.constEnd(), middle,
+                                     [] (const QRect &r, int y) { return r.bottom() + PAGE_SPACING < y; });
+    if (it == _pageGeometries.constEnd()) {
+        return;
+    }
+
+    const int page = int(it - _pageGeometries.constBegin());
+    if (page != _currentPage) {
+        _currentPage = page;
+        Q_EMIT currentPageChanged(_currentPage);
+    }
+}
+
+
+QRect PageView::pageRect(int page) const
+{
+    return _pageGeometries.at(page).translated(-horizontalScrollBar()->value(), -verticalScrollBar()->value());
+}
+
+
+RenderKey PageView::renderKey(int page, int tile) const
+{
+    return RenderKey(_document, page, _zoomFactor, devicePixelRatioF(), tile, _colorMode);
+}
+
+
+QVector<RenderKey> PageView::renderKeys(int page, const QRect &area) const
+{
+    QVector<RenderKey> keys;
+
+    const QSize size = renderSize(page);
+    if (!RenderCache::isTiled(size)) {
+        keys.append( renderKey(page) );
+        return keys;
+    }
+
+    // tiles are in device pixels
+    const qreal dpr = devicePixelRatioF();
+    const QRect deviceArea = QRectF(area.topLeft() * dpr, area.size() * dpr).toAlignedRect()
+                                 .intersected( QRect(QPoint(0, 0), size) );
+    if (deviceArea.isEmpty()) {
+        return keys;
+    }
+
+    const int tileSize = RenderCache::TILE_SIZE;
+    const int columns = RenderCache::tileColumns(size);
+    for (int row = deviceArea.top() / tileSize; row <= deviceArea.bottom() / tileSize; ++row) {
+        for (int col = deviceArea.left() / tileSize; col <= deviceArea.right() / tileSize; ++col) {
+            keys.append( renderKey(page, row * columns + col) );
+        }
+    }
+    return keys;
+}
+
+
+QRect PageView::leadingArea(int page, int direction) const
+{
+    const QRect geometry = _pageGeometries.at(page);
+
+    // the columns in view, and a viewport worth of rows from the entering edge
+    const int left = qMax(0, horizontalScrollBar()->value() - geometry.left());
+    const int right = qMin(geometry.width(), horizontalScrollBar()->value() + viewport()->width() - geometry.left());
+    const int height = qMin(geometry.height(), viewport()->height());
+    const int top = direction > 0 ? 0 : geometry.height() - height;
+
+    return QRect(left, top, right - left, height);
+}
+
+
+QSize PageView::renderSize(int page) const
+{
+    return _pageGeometries.at(page).size() * devicePixelRatioF();
+}
+
+
+void PageView::paintEvent(QPaintEvent *event)
+{
+    const int first = firstVisiblePage();
+    if (first < 0) {
+        return;
+    }
+    const int last = lastVisiblePage();
+
+    QPainter painter(viewport());
+
+    const qreal dpr = devicePixelRatioF();
+
+    for (int page = first; page <= last; ++page) {
+        const QRect rect = pageRect(page);
+        const QRect exposed = rect.intersected(event->rect());
+        if (exposed.isEmpty()) {
+            continue;
+        }
+
+        // only the images covering the exposed part are requested
+        const QSize size = renderSize(page);
+        const QVector<RenderKey> keys = renderKeys(page, exposed.translated(-rect.topLeft()));
+        for (const RenderKey &key : keys) {
+            QRectF target = rect;
+            if (key.tile >= 0) {
+                const QRect tile = RenderCache::tileRect(size, key.tile);
+                target = QRectF(QPointF(tile.topLeft()) / dpr, QSizeF(tile.size()) / dpr).translated(rect.topLeft());
+            }
+
+            const QImage image = _cache->image(key, true);
+            if (image.isNull()) {
+                painter.fillRect(target, _blankColor);
+                _cache->request(key, size);
+                continue;
+            }
+            painter.drawImage(target, image);
+
+            if (!_pagePainted) {
+                _pagePainted = true;
+                Q_EMIT firstPagePainted();
+            }
+        }
+    }
+}
+
+
+void PageView::resizeEvent(QResizeEvent *event)
+{
+    QAbstractScrollArea::resizeEvent(event);
+
+    // pages are centered in the viewport
+    updateLayout();
+    updateCurrentPage();
+}
+
+
+void PageView::scrollContentsBy(int dx, int dy)
+{
+    Q_UNUSED(dx)
+    Q_UNUSED(dy)
+
+    viewport()->update();
+    updateCurrentPage();
+}
+
+
+void PageView::onPageRendered(const QPdfDocument *document, int page)
+{
+    if (document != _document || page < firstVisiblePage() || page > lastVisiblePage()) {
+        return;
+    }
+    viewport()->update( pageRect(page) );
+}
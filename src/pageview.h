@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef PAGEVIEW_H
+#define PAGEVIEW_H
+
+
+#include <QAbstractScrollArea>
+#include <QColor>
+#include <QVector>
+
+class QPdfDocument;
+
+class RenderCache;
+struct RenderKey;
+
+
+// Shows the pages of a document one below the other.
+// Pages are painted from the (shared) render cache: the missing ones
+// are requested to it and painted as soon as they are rendered.
+class PageView : public QAbstractScrollArea
+{
+    Q_OBJECT
+
+public:
+    explicit PageView(RenderCache *cache, QWidget *parent = nullptr);
+
+    // keepPosition leaves the viewport on the same part of the same
+    // page, as for a new version of the document shown
+    void setDocument(QPdfDocument *document, bool keepPosition = false);
+    inline QPdfDocument* document() const { return _document; }
+
+    void setZoomFactor(qreal factor);
+    inline qreal zoomFactor() const { return _zoomFactor; }
+
+    // a ColorTransform::Mode: pages are rendered again in it
+    void setColorMode(int mode);
+    inline int colorMode() const { return _colorMode; }
+
+    inline int currentPage() const { return _currentPage; }
+    void setCurrentPage(int page);
+
+    inline int pageCount() const { return _pageGeometries.count(); }
+
+    // the pages (partially) shown in the viewport, -1 when none
+    int firstVisiblePage() const;
+    int lastVisiblePage() const;
+
+    // how page is rendered at the current zoom
+    RenderKey renderKey(int page, int tile = -1) const;
+    QSize renderSize(int page) const;
+
+    // the images (the whole page or its tiles) needed to paint
+    // area, given in page coordinates
+    QVector<RenderKey> renderKeys(int page, const QRect &area) const;
+
+    // the part of page entering the viewport first, scrolling in direction
+    QRect leadingArea(int page, int direction) const;
+
+Q_SIGNALS:
+    void documentChanged();
+    void firstPagePainted();
+    void currentPageChanged(int page);
+    void zoomFactorChanged(qreal factor);
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void scrollContentsBy(int dx, int dy) override;
+
+private Q_SLOTS:
+    void onPageRendered(const QPdfDocument *document, int page);
+
+private:
+    void updateLayout();
+    void updateScrollBars();
+    void updateCurrentPage();
+
+    // page geometry, in viewport coordinates
+    QRect pageRect(int page) const;
+
+private:
+    RenderCache* _cache;
+    QPdfDocument* _document;
+
+    qreal _zoomFactor;
+    int _colorMode;
+
+    // what is shown of the pages not rendered yet
+    QColor _blankColor;
+
+    int _currentPage;
+    bool _pagePainted;
+
+    // page sizes (in points), read once from the document
+    QVector<QSizeF> _pageSizes;
+
+    // page geometries, in document coordinates
+    QVector<QRect> _pageGeometries;
+    QSize _documentSize;
+};
+
+#endif // PAGEVIEW_H
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "prefetcher.h"
+
+#include "pageview.h"
+
+#include <QScrollBar>
+
+#include <QtMath>
+
+
+// pages always kept ready ahead, and the most ever requested
+static const int MIN_PAGES_AHEAD = 2;
+static const int MAX_PAGES_AHEAD = 8;
+
+// how far in the future pages are prefetched, at the current velocity
+static const int LOOKAHEAD_MSECS = 400;
+
+// a pause longer than this restarts the velocity estimation
+static const int IDLE_MSECS = 500;
+
+
+Prefetcher::Prefetcher(PageView *view, RenderCache *cache)
+    : QObject(view)
+    , _view(view)
+    , _cache(cache)
+    , _lastValue(0)
+    , _direction(1)
+    , _velocity(0)
+{
+    _clock.start();
+
+    connect(_view->verticalScrollBar(), &QScrollBar::valueChanged, this, &Prefetcher::onScrolled);
+    connect(_view, &PageView::documentChanged, this, &Prefetcher::onDocumentChanged);
+    connect(_view, &PageView::zoomFactorChanged, this, [=] () {
+            // what was requested is for the old zoom
+            cancel();
+            prefetch();
+        }
+    );
+}
+
+
+void Prefetcher::onDocumentChanged()
+{
+    // the keys of the old document are dropped by its removal from the cache
+    _requested.clear();
+
+    _lastValue = _view->verticalScrollBar()->value();
+    _direction = 1;
+    _velocity = 0;
+    _clock.restart();
+
+    prefetch();
+}
+
+
+void Prefetcher::onScrolled(int value)
+{
+    const int delta = value - _lastValue;
+    _lastValue = value;
+    if (delta == 0) {
+        return;
+    }
+
+    const qint64 elapsed = _clock.restart();
+    const qreal velocity = qAbs(delta) / qreal(qMax<qint64>(elapsed, 16));
+    if (elapsed > IDLE_MSECS) {
+        _velocity = velocity;
+    } else {
+        // smooth the spikes of wheel and key scrolling
+        _velocity = 0.7 * _velocity + 0.3 * velocity;
+    }
+
+    const int direction = delta > 0 ? 1 : -1;
+    if (direction != _direction) {
+        _direction = direction;
+        cancel();
+    }
+
+    prefetch();
+}
+
+
+int Prefetcher::pagesAhead() const
+{
+    const int page = _view->currentPage();
+    const int pageHeight = qRound(_view->renderSize(page).height() / _view->devicePixelRatioF());
+    if (pageHeight <= 0) {
+        return MIN_PAGES_AHEAD;
+    }
+
+    const int pages = qCeil(_velocity * LOOKAHEAD_MSECS / pageHeight);
+    return qBound(MIN_PAGES_AHEAD, pages + 1, MAX_PAGES_AHEAD);
+}
+
+
+void Prefetcher::prefetch()
+{
+    if (_view->pageCount() == 0) {
+        return;
+    }
+
+    const int edge = _direction > 0 ? _view->lastVisiblePage() : _view->firstVisiblePage();
+    if (edge < 0) {
+        return;
+    }
+
+    const int count = pagesAhead();
+    QVector<RenderKey> wanted;
+    for (int i = 1; i <= count; ++i) {
+        const int page = edge + i * _direction;
+        if (page < 0 || page >= _view->pageCount()) {
+            break;
+        }
+        // of tiled pages, only the tiles scrolling into view first
+        wanted += _view->renderKeys(page, _view->leadingArea(page, _direction));
+    }
+
+    // pages left behind are not worth rendering anymore
+    for (const RenderKey &key : qAsConst(_requested)) {
+        if (!wanted.contains(key) && !isVisible(key.page)) {
+            _cache->cancel(key, this);
+        }
+    }
+
+    for (const RenderKey &key : qAsConst(wanted)) {
+        _cache->request(key, _view->renderSize(key.page), RenderCache::PrefetchPriority, this);
+    }
+    _requested = wanted;
+}
+
+
+void Prefetcher::cancel()
+{
+    // pages already shown are painted from these same jobs
+    for (const RenderKey &key : qAsConst(_requested)) {
+        if (!isVisible(key.page)) {
+            _cache->cancel(key, this);
+        }
+    }
+    _requested.clear();
+}
+
+
+bool Prefetcher::isVisible(int page) const
+{
+    return page >= _view->firstVisiblePage() && page <= _view->lastVisiblePage();
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef PREFETCHER_H
+#define PREFETCHER_H
+
+
+#include "rendercache.h"
+
+#include <QElapsedTimer>
+#include <QObject>
+#include <QVector>
+
+class PageView;
+
+
+// Renders in advance the pages a view is about to show.
+// It follows the scroll direction and velocity of the view: the faster
+// it goes, the more pages are requested ahead. Going back the other way
+// cancels what was requested and not yet rendered.
+class Prefetcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit Prefetcher(PageView *view, RenderCache *cache);
+
+public Q_SLOTS:
+    void prefetch();
+    void cancel();
+
+private Q_SLOTS:
+    void onScrolled(int value);
+    void onDocumentChanged();
+
+private:
+    int pagesAhead() const;
+    bool isVisible(int page) const;
+
+private:
+    PageView* _view;
+    RenderCache* _cache;
+
+    // scroll state: last position, direction (1 down, -1 up)
+    // and velocity, in pixels per millisecond
+    int _lastValue;
+    int _direction;
+    qreal _velocity;
+    QElapsedTimer _clock;
+
+    QVector<RenderKey> _requested;
+};
+
+#endif // PREFETCHER_H
@@ -0,0 +1,266 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "printjob.h"
+
+#include "rendercache.h"
+#include "tracing.h"
+
+#include <QtConcurrent>
+
+#include <QPdfDocument>
+#include <QPrinter>
+#include <QtMath>
+
+#include <algorithm>
+
+
+// the pages rendered ahead may take this memory at most
+// (a single page takes half of it at most, whatever the paper size)
+static const qint64 PRINT_MEMORY_BUDGET = 256 * 1024 * 1024;
+
+// and they are never more than this
+static const int MAX_PAGES_AHEAD = 4;
+
+
+const int PrintJob::MAX_DPI;
+
+
+static QImage renderForPrint(QPdfDocument *document, int page, const QSize &size, QSharedPointer<QAtomicInt> cancelled)
+{
+    if (cancelled->loadAcquire()) {
+        return QImage();
+    }
+
+    TRACE_SCOPE_ARG("print", "render page", "page", page);
+    return RenderCache::renderPage(document, page, size);
+}
+
+
+// paints a page on the printer once it is rendered: the first one begins the painter
+static bool printPage(QPainter *painter, QPrinter *printer, QFuture<QImage> render,
+                      bool firstPage, QSharedPointer<QAtomicInt> cancelled)
+{
+    const QImage image = render.result();
+    if (cancelled->loadAcquire()) {
+        return false;
+    }
+
+    TRACE_SCOPE("print", "paint page");
+
+    if (firstPage) {
+        if (!painter->begin(printer)) {
+            return false;
+        }
+    } else if (painter->isActive()) {
+        printer->newPage();
+    } else {
+        return false;
+    }
+
+    // the page keeps its aspect ratio, centered in the printable area
+    if (!image.isNull()) {
+        const QRect area = painter->viewport();
+        QRect target( QPoint(0, 0), image.size().scaled(area.size(), Qt::KeepAspectRatio) );
+        target.moveCenter(area.center());
+        painter->drawImage(target, image);
+    }
+    return true;
+}
+
+
+// ends the painter, sending the job to the printer unless it is aborted
+static bool endPrint(QPainter *painter, QPrinter *printer, bool abort)
+{
+    if (!painter->isActive()) {
+        return !abort;
+    }
+
+    TRACE_SCOPE("print", "end print");
+    if (abort) {
+        printer->abort();
+    }
+    return painter->end() && !abort;
+}
+
+
+PrintJob::PrintJob(QPdfDocument *document, QPrinter *printer, QObject *parent)
+    : QObject(parent)
+    , _document(document)
+    , _printer(printer)
+    , _queued(0)
+    , _printed(0)
+    , _queuedBytes(0)
+    , _lowMemory(false)
+    , _ending(false)
+    , _cancelled(new QAtomicInt(0))
+    , _running(false)
+{
+    _pool.setMaxThreadCount( qBound(1, QThread::idealThreadCount(), MAX_PAGES_AHEAD) );
+    _printPool.setMaxThreadCount(1);
+    _printPool.setExpiryTimeout(-1);
+
+    // the range chosen in the print dialog, 1-based (0 is all)
+    const int first = _printer->fromPage() > 0 ? _printer->fromPage() - 1 : 0;
+    const int last = _printer->toPage() > 0 ? qMin(_printer->toPage(), _document->pageCount()) - 1 : _document->pageCount() - 1;
+    for (int page = first; page <= last; ++page) {
+        _pages.append(page);
+    }
+    if (_printer->pageOrder() == QPrinter::LastPageFirst) {
+        std::reverse(_pages.begin(), _pages.end());
+    }
+
+    connect(&_watcher, &QFutureWatcherBase::finished, this, &PrintJob::onPagePrinted);
+}
+
+
+PrintJob::~PrintJob()
+{
+    cancel();
+}
+
+
+void PrintJob::start()
+{
+    if (_running) {
+        return;
+    }
+
+    if (_pages.isEmpty()) {
+        Q_EMIT finished(false);
+        return;
+    }
+    _running = true;
+
+    queuePages();
+    _watcher.setFuture(_prints.head());
+}
+
+
+void PrintJob::cancel()
+{
+    if (!_running) {
+        return;
+    }
+
+    _cancelled->storeRelease(1);
+    stop(true);
+
+    Q_EMIT finished(false);
+}
+
+
+void PrintJob::onPagePrinted()
+{
+    // the job is sent to the printer
+    if (_ending) {
+        const bool completed = _watcher.result();
+        _ending = false;
+        _running = false;
+        Q_EMIT finished(completed);
+        return;
+    }
+
+    const bool printed = _prints.dequeue().result();
+    _queuedBytes -= _renderBytes.dequeue();
+
+    // the printer could not be opened
+    if (!printed) {
+        _cancelled->storeRelease(1);
+        stop(true);
+        Q_EMIT finished(false);
+        return;
+    }
+
+    _printed++;
+    Q_EMIT progress(_printed);
+
+    queuePages();
+    if (!_prints.isEmpty()) {
+        _watcher.setFuture(_prints.head());
+        return;
+    }
+
+    _ending = true;
+    _watcher.setFuture( QtConcurrent::run(&_printPool, endPrint, &_painter, _printer.data(), false) );
+}
+
+
+void PrintJob::queuePages()
+{
+    const int pagesAhead = _lowMemory ? 1 : MAX_PAGES_AHEAD;
+    while (_queued < _pages.count() && _prints.count() < pagesAhead) {
+        const int page = _pages.at(_queued);
+        const QSize size = renderSize(page);
+        // the render is copied once on a white background
+        const qint64 bytes = qint64(size.width()) * size.height() * 4 * 2;
+
+        if (!_prints.isEmpty() && _queuedBytes + bytes > PRINT_MEMORY_BUDGET) {
+            return;
+        }
+
+        const QFuture<QImage> render = QtConcurrent::run(&_pool, renderForPrint, _document, page, size, _cancelled);
+        _prints.enqueue( QtConcurrent::run(&_printPool, printPage, &_painter, _printer.data(), render, _queued == 0, _cancelled) );
+        _renderBytes.enqueue(bytes);
+        _queuedBytes += bytes;
+        _queued++;
+    }
+}
+
+
+qint64 PrintJob::trimMemory(qint64 bytes)
+{
+    Q_UNUSED(bytes)
+
+    // the pages queued are all needed: the next ones are queued one by one
+    _lowMemory = true;
+    return 0;
+}
+
+
+QSize PrintJob::renderSize(int page) const
+{
+    // the page fit in the printable area, at the printer resolution...
+    const int resolution = _printer->resolution();
+    const QSize area = _printer->pageLayout().paintRectPixels(resolution).size();
+    QSize size = _document->pageSize(page).scaled(area, Qt::KeepAspectRatio).toSize();
+
+    // ...up to MAX_DPI: the painter scales it up to the printer resolution
+    if (resolution > MAX_DPI) {
+        size = size * (qreal(MAX_DPI) / resolution);
+    }
+
+    // and in half the memory budget, for the largest paper sizes
+    const qint64 maxPixels = PRINT_MEMORY_BUDGET / 2 / (4 * 2);
+    const qint64 pixels = qint64(size.width()) * size.height();
+    if (pixels > maxPixels) {
+        size = size * qSqrt( qreal(maxPixels) / pixels );
+    }
+
+    return size.expandedTo( QSize(1, 1) );
+}
+
+
+void PrintJob::stop(bool abort)
+{
+    // cancelled renders and prints return at once
+    _watcher.disconnect(this);
+    _pool.waitForDone();
+
+    // the painter is used by its own thread only
+    QtConcurrent::run(&_printPool, endPrint, &_painter, _printer.data(), abort).waitForFinished();
+    _printPool.waitForDone();
+
+    _prints.clear();
+    _renderBytes.clear();
+    _queuedBytes = 0;
+
+    _ending = false;
+    _running = false;
+}
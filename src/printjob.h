@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef PRINTJOB_H
+#define PRINTJOB_H
+
+
+#include <QAtomicInt>
+#include <QFutureWatcher>
+#include <QImage>
+#include <QObject>
+#include <QPainter>
+#include <QQueue>
+#include <QScopedPointer>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVector>
+
+#include "memorygovernor.h"
+
+class QPdfDocument;
+class QPrinter;
+
+
+// Prints a document without blocking the GUI.
+// Pages are rendered at the printer resolution (MAX_DPI at most) by a
+// thread pool, a few ahead of the one being printed, and painted on the
+// printer in order by a thread of their own: the images alive at the same
+// time are bounded, whatever the page count and the printer resolution.
+// Under memory pressure, only one page is rendered ahead.
+class PrintJob : public QObject, public MemoryConsumer
+{
+    Q_OBJECT
+
+public:
+    // the largest resolution pages are rendered at: 1200 dpi printers
+    // would take more than 500 MB for an A4 page
+    static const int MAX_DPI = 300;
+
+    // takes ownership of printer, already set up (by a QPrintDialog)
+    PrintJob(QPdfDocument *document, QPrinter *printer, QObject *parent = nullptr);
+
+    // cancels the job, if still running
+    ~PrintJob();
+
+    void start();
+
+    // the pages to be printed
+    inline int pageCount() const { return _pages.count(); }
+
+    inline qint64 memoryUsed() const override { return _queuedBytes; }
+    qint64 trimMemory(qint64 bytes) override;
+
+public Q_SLOTS:
+    // waits for the pages being rendered and printed: document can be
+    // deleted after it
+    void cancel();
+
+Q_SIGNALS:
+    void progress(int printedPages);
+    void finished(bool completed);
+
+private Q_SLOTS:
+    void onPagePrinted();
+
+private:
+    void queuePages();
+    QSize renderSize(int page) const;
+    // abort drops what was printed already
+    void stop(bool abort);
+
+private:
+    QPdfDocument* _document;
+    QScopedPointer<QPrinter> _printer;
+    QPainter _painter;
+
+    // page numbers in printing order, and how many have been queued and printed
+    QVector<int> _pages;
+    int _queued;
+    int _printed;
+
+    // the queued pages, in printing order: each one is rendered by _pool
+    // and painted by _printPool, the watcher follows the first one
+    QQueue<QFuture<bool> > _prints;
+    QQueue<qint64> _renderBytes;
+    qint64 _queuedBytes;
+    bool _lowMemory;
+    QFutureWatcher<bool> _watcher;
+    bool _ending;
+
+    QThreadPool _pool;
+    // the painter is used by a single thread, in printing order
+    QThreadPool _printPool;
+    QSharedPointer<QAtomicInt> _cancelled;
+    bool _running;
+};
+
+#endif // PRINTJOB_H
@@ -0,0 +1,473 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "rendercache.h"
+
+#include "colortransform.h"
+#include "diskcache.h"
+#include "tracing.h"
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QPainter>
+#include <QPdfDocument>
+#include <QStandardPaths>
+#include <QRunnable>
+
+#include <climits>
+
+
+// default budget: 256 MiB
+static const qint64 DEFAULT_BUDGET = 256 * 1024 * 1024;
+
+// renders quicker than this are not worth the disk space
+static const qint64 DISK_CACHE_MIN_RENDER_TIME = 50;
+
+
+class RenderJob : public QRunnable
+{
+public:
+    RenderJob(RenderCache *cache, const QSharedPointer<RenderTarget> &target, const RenderKey &key, const QSize &size,
+              DiskCache *diskCache, const QString &diskName, MemoryGovernor *governor)
+        : _cache(cache)
+        , _target(target)
+        , _key(key)
+        , _size(size)
+        , _diskCache(diskCache)
+        , _diskName(diskName)
+        , _governor(governor)
+        , _cancelled(0)
+    {
+        // jobs are deleted by the cache, once it got their result
+        setAutoDelete(false);
+    }
+
+    void run() override
+    {
+        TRACE_SCOPE_ARG("render", "render job", "page", _key.page);
+
+        QElapsedTimer timer;
+        timer.start();
+
+        // a page rendered in a previous session
+        QImage image;
+        if (!_diskName.isEmpty() && !_cancelled.loadAcquire()) {
+            image = _diskCache->read(_diskName);
+        }
+
+        if (image.isNull() && !_cancelled.loadAcquire()) {
+            // the library image and the opaque copy of it: under memory
+            // pressure the render waits for the running ones
+            const QSize imageSize = _key.tile < 0 ? _size : RenderCache::tileRect(_size, _key.tile).size();
+            const qint64 bufferBytes = 2 * 4 * qint64(imageSize.width()) * imageSize.height();
+            if (_governor) {
+                _governor->acquireBuffer(bufferBytes);
+            }
+
+            QReadLocker locker(&_target->lock);
+            if (!_target->closed) {
+                if (_key.tile < 0) {
+                    image = RenderCache::renderPage(_target->document, _key.page, _size);
+                } else {
+                    // the tile is a clip of the whole page, scaled at size
+                    const QRect rect = RenderCache::tileRect(_size, _key.tile);
+                    QPdfDocumentRenderOptions options;
+                    options.setScaledSize(_size);
+                    options.setScaledClipRect(rect);
+                    image = RenderCache::renderPage(_target->document, _key.page, rect.size(), options);
+                }
+            }
+
+            locker.unlock();
+
+            // in place, while the buffer is still accounted for
+            ColorTransform::apply( image, ColorTransform::mode(_key.colorMode) );
+
+            if (_governor) {
+                _governor->releaseBuffer(bufferBytes);
+            }
+
+            if (!_diskName.isEmpty() && timer.elapsed() >= DISK_CACHE_MIN_RENDER_TIME) {
+                _diskCache->write(_diskName, image);
+            }
+        }
+        image.setDevicePixelRatio(_key.dpr / 100.0);
+
+        const qint64 renderTime = timer.elapsed();
+
+        RenderCache* cache = _cache;
+        RenderJob* job = this;
+        QMetaObject::invokeMethod(cache, [=] () {
+                cache->jobFinished(job, image, renderTime);
+            }, Qt::QueuedConnection
+        );
+    }
+
+    inline RenderKey key() const { return _key; }
+    inline void cancel() { _cancelled.storeRelease(1); }
+    inline bool isCancelled() const { return _cancelled.loadAcquire(); }
+
+private:
+    RenderCache* _cache;
+    QSharedPointer<RenderTarget> _target;
+    RenderKey _key;
+    QSize _size;
+    DiskCache* _diskCache;
+    QString _diskName;
+    MemoryGovernor* _governor;
+    QAtomicInt _cancelled;
+};
+
+
+// the name of the file keeping key in the disk cache
+static QString diskName(const QByteArray &contentHash, const RenderKey &key)
+{
+    return QString::fromLatin1( contentHash.toHex() )
+         + QStringLiteral("-%1-%2-%3-%4-%5.page").arg(key.page).arg(key.zoom).arg(key.dpr).arg(key.tile).arg(key.colorMode);
+}
+
+
+QImage RenderCache::renderPage(QPdfDocument *document, int page, const QSize &imageSize,
+                               const QPdfDocumentRenderOptions &options)
+{
+    TRACE_SCOPE_ARG("render", "render page", "page", page);
+
+    // the PDF library leaves the page background transparent
+    const QImage rendered = document->render(page, imageSize, options);
+    if (rendered.isNull()) {
+        return rendered;
+    }
+
+    QImage image(rendered.size(), QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::white);
+    QPainter painter(&image);
+    painter.drawImage(0, 0, rendered);
+    painter.end();
+    return image;
+}
+
+
+const int RenderKey::THUMBNAIL_TILE;
+const int RenderCache::TILE_SIZE;
+const int RenderCache::MAX_UNTILED_SIZE;
+
+
+bool RenderCache::isTiled(const QSize &pageSize)
+{
+    return pageSize.width() > MAX_UNTILED_SIZE || pageSize.height() > MAX_UNTILED_SIZE;
+}
+
+
+int RenderCache::tileColumns(const QSize &pageSize)
+{
+    return (pageSize.width() + TILE_SIZE - 1) / TILE_SIZE;
+}
+
+
+QRect RenderCache::tileRect(const QSize &pageSize, int tile)
+{
+    const int columns = tileColumns(pageSize);
+    const QRect rect((tile % columns) * TILE_SIZE, (tile / columns) * TILE_SIZE, TILE_SIZE, TILE_SIZE);
+    return rect.intersected( QRect(QPoint(0, 0), pageSize) );
+}
+
+
+RenderCache::RenderCache(QObject *parent)
+    : QObject(parent)
+    , _diskCache(new DiskCache( QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QLatin1String("/pages") ))
+    , _memoryGovernor(nullptr)
+    , _hits(0)
+    , _misses(0)
+    , _lastRenderTime(-1)
+{
+    setBudget(DEFAULT_BUDGET);
+}
+
+
+RenderCache::~RenderCache()
+{
+    _pool.clear();
+    _pool.waitForDone();
+
+    // finished jobs whose result was never delivered
+    qDeleteAll(_jobs);
+
+    delete _diskCache;
+}
+
+
+void RenderCache::setBudget(qint64 bytes)
+{
+    _images.setMaxCost( int(qBound(qint64(1), bytes / 1024, qint64(INT_MAX))) );
+}
+
+
+qint64 RenderCache::budget() const
+{
+    return qint64(_images.maxCost()) * 1024;
+}
+
+
+qint64 RenderCache::bytesUsed() const
+{
+    return qint64(_images.totalCost()) * 1024;
+}
+
+
+void RenderCache::setMemoryGovernor(MemoryGovernor *governor)
+{
+    _memoryGovernor = governor;
+    if (governor) {
+        governor->addConsumer(this, MemoryGovernor::RenderCachePriority);
+    }
+}
+
+
+qint64 RenderCache::memoryUsed() const
+{
+    return bytesUsed();
+}
+
+
+qint64 RenderCache::trimMemory(qint64 bytes)
+{
+    // a lower max cost drops the least recently used images at once
+    const int before = _images.totalCost();
+    const int maxCost = _images.maxCost();
+    _images.setMaxCost( qMax(0, before - int(qMin(bytes / 1024, qint64(before)))) );
+    _images.setMaxCost(maxCost);
+
+    return qint64(before - _images.totalCost()) * 1024;
+}
+
+
+void RenderCache::setDiskBudget(qint64 bytes)
+{
+    _diskCache->setBudget(bytes);
+}
+
+
+qint64 RenderCache::diskBudget() const
+{
+    return _diskCache->budget();
+}
+
+
+void RenderCache::setContentHash(const QPdfDocument *document, const QByteArray &hash)
+{
+    _contentHashes.insert(document, hash);
+}
+
+
+qreal RenderCache::hitRate() const
+{
+    const qint64 lookups = _hits + _misses;
+    return lookups ? qreal(_hits) / lookups : 0.0;
+}
+
+
+QImage RenderCache::image(const RenderKey &key, bool painted)
+{
+    TRACE_SCOPE_ARG("cache", "cache lookup", "page", key.page);
+
+    // QCache::object() also marks key as the most recently used
+    QImage* image = _images.object(key);
+    if (!image) {
+        if (painted && !_missed.contains(key)) {
+            _missed.insert(key);
+            _misses++;
+        }
+        return QImage();
+    }
+    if (painted) {
+        _hits++;
+    }
+    return *image;
+}
+
+
+bool RenderCache::contains(const RenderKey &key) const
+{
+    return _images.contains(key);
+}
+
+
+void RenderCache::request(const RenderKey &key, const QSize &size, int priority, const void *requester)
+{
+    if (_images.contains(key) || size.isEmpty()) {
+        return;
+    }
+
+    // asked by another window (or another part of this one)
+    auto it = _pending.find(key);
+    if (it != _pending.end()) {
+        PendingJob &pending = it.value();
+        pending.requesters.insert(requester);
+        if (priority > pending.priority && _pool.tryTake(pending.job)) {
+            _pool.start(pending.job, priority);
+        }
+        pending.priority = qMax(pending.priority, priority);
+        return;
+    }
+
+    const QByteArray contentHash = _contentHashes.value(key.document);
+    const QString name = !contentHash.isEmpty() && _diskCache->isEnabled() ? diskName(contentHash, key) : QString();
+
+    PendingJob pending;
+    pending.job = new RenderJob(this, target(key.document), key, size, _diskCache, name, _memoryGovernor);
+    pending.priority = priority;
+    pending.requesters.insert(requester);
+    _pending.insert(key, pending);
+    _jobs.insert(pending.job);
+    _pool.start(pending.job, priority);
+}
+
+
+void RenderCache::cancel(const RenderKey &key, const void *requester)
+{
+    auto it = _pending.find(key);
+    if (it == _pending.end()) {
+        return;
+    }
+
+    // still wanted by someone else
+    it.value().requesters.remove(requester);
+    if (it.value().requesters.isEmpty()) {
+        dropJob(key);
+    }
+}
+
+
+void RenderCache::dropJob(const RenderKey &key)
+{
+    _missed.remove(key);
+
+    RenderJob* job = _pending.take(key).job;
+    if (!job) {
+        return;
+    }
+
+    if (_pool.tryTake(job)) {
+        _jobs.remove(job);
+        delete job;
+        return;
+    }
+
+    // already running: its result will be dropped
+    job->cancel();
+}
+
+
+void RenderCache::removeDocument(const QPdfDocument *document)
+{
+    const QList<RenderKey> pendingKeys = _pending.keys();
+    for (const RenderKey &key : pendingKeys) {
+        if (key.document == document) {
+            dropJob(key);
+        }
+    }
+
+    const QList<RenderKey> cachedKeys = _images.keys();
+    for (const RenderKey &key : cachedKeys) {
+        if (key.document == document) {
+            _images.remove(key);
+        }
+    }
+
+    for (auto it = _missed.begin(); it != _missed.end(); ) {
+        if (it->document == document) {
+            it = _missed.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    _contentHashes.remove(document);
+
+    QSharedPointer<RenderTarget> t = _targets.take(document);
+    if (t) {
+        // waits for the jobs still rendering it
+        QWriteLocker locker(&t->lock);
+        t->closed = true;
+    }
+}
+
+
+void RenderCache::movePages(const QPdfDocument *from, const QPdfDocument *to, const QHash<int, int> &pages)
+{
+    TRACE_SCOPE_ARG("render", "move pages", "pages", pages.count());
+
+    // page of from -> pages of to: a page may even be there twice
+    QMultiHash<int, int> targets;
+    for (auto it = pages.constBegin(); it != pages.constEnd(); ++it) {
+        targets.insert(it.value(), it.key());
+    }
+
+    const QList<RenderKey> cachedKeys = _images.keys();
+    for (const RenderKey &key : cachedKeys) {
+        if (key.document != from || !targets.contains(key.page)) {
+            continue;
+        }
+
+        // the images are implicitly shared: no pixel is copied
+        QImage* image = _images.take(key);
+        if (!image) {
+            // evicted by the ones moved before it
+            continue;
+        }
+        const int cost = qMax(1, int(image->sizeInBytes() / 1024));
+        const QList<int> toPages = targets.values(key.page);
+        for (int page : toPages) {
+            RenderKey toKey = key;
+            toKey.document = to;
+            toKey.page = page;
+            _images.insert(toKey, new QImage(*image), cost);
+        }
+        delete image;
+    }
+}
+
+
+QSharedPointer<RenderTarget> RenderCache::target(const QPdfDocument *document)
+{
+    QSharedPointer<RenderTarget> t = _targets.value(document);
+    if (!t) {
+        t.reset(new RenderTarget);
+        t->document = const_cast<QPdfDocument*>(document);
+        _targets.insert(document, t);
+    }
+    return t;
+}
+
+
+void RenderCache::jobFinished(RenderJob *job, const QImage &image, qint64 renderTime)
+{
+    const RenderKey key = job->key();
+
+    _jobs.remove(job);
+
+    // a cancelled job may have been replaced by a new one
+    if (_pending.value(key).job == job) {
+        _pending.remove(key);
+        _missed.remove(key);
+    }
+
+    // QCache refuses (and deletes) images bigger than the whole budget:
+    // nobody is told about them, not to request them again and again
+    if (!job->isCancelled() && !image.isNull()) {
+        _lastRenderTime = renderTime;
+
+        const int cost = qMax(1, int(image.sizeInBytes() / 1024));
+        if (_images.insert(key, new QImage(image), cost)) {
+            Q_EMIT pageRendered(key.document, key.page);
+        }
+    }
+
+    delete job;
+}
@@ -0,0 +1,221 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef RENDERCACHE_H
+#define RENDERCACHE_H
+
+
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QObject>
+#include <QPdfDocumentRenderOptions>
+#include <QReadWriteLock>
+#include <QSet>
+#include <QSharedPointer>
+#include <QThreadPool>
+
+#include "memorygovernor.h"
+
+class QPdfDocument;
+
+class DiskCache;
+class RenderJob;
+
+
+// What identifies a rendered page (or a tile of it): zoom and device pixel
+// ratio are kept as integers (per mille and percent) to be safely hashed.
+// Whole pages have tile -1, their thumbnails THUMBNAIL_TILE.
+// The color mode is a ColorTransform::Mode, applied once by the render.
+struct RenderKey
+{
+    const QPdfDocument* document = nullptr;
+    int page = -1;
+    int zoom = 1000;
+    int dpr = 100;
+    int tile = -1;
+    int colorMode = 0;
+
+    static const int THUMBNAIL_TILE = -2;
+
+    RenderKey() {}
+    RenderKey(const QPdfDocument *doc, int pageNumber, qreal zoomFactor, qreal devicePixelRatio, int tileIndex = -1,
+              int mode = 0)
+        : document(doc)
+        , page(pageNumber)
+        , zoom(qRound(zoomFactor * 1000))
+        , dpr(qRound(devicePixelRatio * 100))
+        , tile(tileIndex)
+        , colorMode(mode)
+    {}
+};
+
+inline bool operator==(const RenderKey &a, const RenderKey &b)
+{
+    return a.document == b.document
+        && a.page == b.page
+        && a.zoom == b.zoom
+        && a.dpr == b.dpr
+        && a.tile == b.tile
+        && a.colorMode == b.colorMode;
+}
+
+inline uint qHash(const RenderKey &key, uint seed = 0)
+{
+    return qHash(quintptr(key.document), seed)
+         ^ (qHash(key.page, seed) * 31)
+         ^ (qHash(key.zoom, seed) * 131)
+         ^ (qHash(key.dpr, seed) * 1031)
+         ^ (qHash(key.tile, seed) * 10007)
+         ^ (qHash(key.colorMode, seed) * 100003);
+}
+
+
+// A document seen by the render workers.
+// Workers render holding the lock for reading, removeDocument() takes it
+// for writing, so that a document is never closed under a running job.
+struct RenderTarget
+{
+    QPdfDocument* document = nullptr;
+    QReadWriteLock lock;
+    bool closed = false;
+};
+
+
+// Rendered pages, shared by all the windows.
+// Missing pages are rendered by a thread pool and kept in a LRU cache
+// whose size is bounded by a byte budget.
+// Pages too big to be rendered in one image (at high zoom levels) are
+// split in square tiles, rendered and cached one by one.
+// Behind the memory cache there is a disk one, lasting across sessions,
+// for the documents whose content hash is known.
+// Under memory pressure, the least recently used images are the first
+// given back to the memory governor.
+class RenderCache : public QObject, public MemoryConsumer
+{
+    Q_OBJECT
+
+public:
+    // tile side, and biggest page rendered whole (in device pixels)
+    static const int TILE_SIZE = 1024;
+    static const int MAX_UNTILED_SIZE = 4096;
+
+    // renders page (a clip of it, if options say so) on a white
+    // background: the result is opaque, ARGB32 premultiplied
+    static QImage renderPage(QPdfDocument *document, int page, const QSize &imageSize,
+                             const QPdfDocumentRenderOptions &options = QPdfDocumentRenderOptions());
+
+    static bool isTiled(const QSize &pageSize);
+    static int tileColumns(const QSize &pageSize);
+    static QRect tileRect(const QSize &pageSize, int tile);
+
+    // the priorities of the render jobs
+    enum Priority {
+        ThumbnailPriority = -10,
+        PrefetchPriority = 0,
+        VisiblePriority = 10
+    };
+
+    explicit RenderCache(QObject *parent = nullptr);
+    ~RenderCache();
+
+    void setBudget(qint64 bytes);
+    qint64 budget() const;
+    qint64 bytesUsed() const;
+
+    // the renders queued or running (search, thumbnail files, print and save
+    // work are not renders of the cache)
+    inline int pendingRenders() const { return _pending.count(); }
+
+    // render buffers are accounted by governor, and the images trimmed by it
+    void setMemoryGovernor(MemoryGovernor *governor);
+    inline MemoryGovernor* memoryGovernor() const { return _memoryGovernor; }
+
+    qint64 memoryUsed() const override;
+    qint64 trimMemory(qint64 bytes) override;
+
+    // the disk cache budget: 0 (the default) disables it
+    void setDiskBudget(qint64 bytes);
+    qint64 diskBudget() const;
+
+    // documents are found in the disk cache by the hash of their content
+    void setContentHash(const QPdfDocument *document, const QByteArray &hash);
+
+    // paint lookups that found the image, and the ones that did not
+    // (a page still rendering is missed once, whatever the repaints)
+    inline qint64 hits() const { return _hits; }
+    inline qint64 misses() const { return _misses; }
+    qreal hitRate() const;
+
+    // how long the last page (or tile) took to render, in ms (-1 if none yet)
+    inline qint64 lastRenderTime() const { return _lastRenderTime; }
+
+    // returns the cached image, or a null one;
+    // only the lookups of a paint are counted in the hit rate
+    QImage image(const RenderKey &key, bool painted = false);
+    bool contains(const RenderKey &key) const;
+
+    // queues the render of key for a page of size (in device pixels),
+    // if it is not already cached or queued: a job already queued gets
+    // the highest priority it was requested with.
+    // The windows share the jobs: a job is cancelled once every requester
+    // cancelled it, and requests without a requester are never cancelled
+    void request(const RenderKey &key, const QSize &size, int priority = VisiblePriority,
+                 const void *requester = nullptr);
+    void cancel(const RenderKey &key, const void *requester);
+
+    // drops everything about document: it has to be called before it is deleted
+    void removeDocument(const QPdfDocument *document);
+
+    // hands the cached images of the pages of from that did not change
+    // (page of to -> page of from) over to to, a new version of it
+    void movePages(const QPdfDocument *from, const QPdfDocument *to, const QHash<int, int> &pages);
+
+Q_SIGNALS:
+    void pageRendered(const QPdfDocument *document, int page);
+
+private:
+    friend class RenderJob;
+    void jobFinished(RenderJob *job, const QImage &image, qint64 renderTime);
+
+    QSharedPointer<RenderTarget> target(const QPdfDocument *document);
+
+    // cancels the job of key, whoever requested it
+    void dropJob(const RenderKey &key);
+
+private:
+    struct PendingJob
+    {
+        RenderJob* job = nullptr;
+        int priority = 0;
+        QSet<const void*> requesters;
+    };
+
+    QThreadPool _pool;
+
+    // image costs are in KiB, to fit large budgets in an int
+    QCache<RenderKey, QImage> _images;
+
+    // the jobs to be rendered, and all the ones still alive (cancelled too)
+    QHash<RenderKey, PendingJob> _pending;
+    QSet<RenderJob*> _jobs;
+    QHash<const QPdfDocument*, QSharedPointer<RenderTarget> > _targets;
+
+    DiskCache* _diskCache;
+    MemoryGovernor* _memoryGovernor;
+    QHash<const QPdfDocument*, QByteArray> _contentHashes;
+
+    qint64 _hits;
+    qint64 _misses;
+    // missed by a paint, until rendered (or given up)
+    QSet<RenderKey> _missed;
+    qint64 _lastRenderTime;
+};
+
+#endif // RENDERCACHE_H
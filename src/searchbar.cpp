@@ -20,6 +20,9 @@ SearchBar::SearchBar(QWidget *parent)
     : QWidget(parent)
     , _findLineEdit( new QLineEdit(this) )
     , _caseCheckBox( new QCheckBox( tr("Match Case") , this) )
+    , _wordsCheckBox( new QCheckBox( tr("Whole Words") , this) )
+    , _diacriticsCheckBox( new QCheckBox( tr("Ignore Accents") , this) )
+    , _regexCheckBox( new QCheckBox( tr("Regular Expression") , this) )
     , _notFoundLabel( new QLabel(this) )
 {
     connect(_findLineEdit, &QLineEdit::returnPressed, this, &SearchBar::findForward);
@@ -48,6 +51,9 @@ SearchBar::SearchBar(QWidget *parent)
     layout->addWidget (nextButton);
     layout->addWidget (prevButton);
     layout->addWidget (_caseCheckBox);
+    layout->addWidget (_wordsCheckBox);
+    layout->addWidget (_diacriticsCheckBox);
+    layout->addWidget (_regexCheckBox);
     layout->addStretch();
     layout->addWidget (_notFoundLabel);
     layout->addStretch();
@@ -60,6 +66,9 @@ SearchBar::SearchBar(QWidget *parent)
     setTabOrder(_findLineEdit, nextButton);
     setTabOrder(nextButton, prevButton);
     setTabOrder(prevButton,_caseCheckBox);
+    setTabOrder(_caseCheckBox, _wordsCheckBox);
+    setTabOrder(_wordsCheckBox, _diacriticsCheckBox);
+    setTabOrder(_diacriticsCheckBox, _regexCheckBox);
 }
 
 
@@ -81,13 +90,23 @@ bool SearchBar::caseChecked()
 }
 
 
+SearchEngine::SearchFlags SearchBar::flags()
+{
+    SearchEngine::SearchFlags flags;
+    flags.setFlag(SearchEngine::CaseSensitive, _caseCheckBox->isChecked());
+    flags.setFlag(SearchEngine::WholeWords, _wordsCheckBox->isChecked());
+    flags.setFlag(SearchEngine::IgnoreDiacritics, _diacriticsCheckBox->isChecked());
+    flags.setFlag(SearchEngine::RegularExpression, _regexCheckBox->isChecked());
+    return flags;
+}
+
+
 void SearchBar::findBackward()
 {
     _notFoundLabel->clear();
 
     QString str = _findLineEdit->text();
-    bool caseSensitive = _caseCheckBox->isChecked();
-    Q_EMIT search(str, false, caseSensitive);
+    Q_EMIT search(str, false, flags());
 }
 
 
@@ -96,8 +115,7 @@ void SearchBar::findForward()
     _notFoundLabel->clear();
 
     QString str = _findLineEdit->text();
-    bool caseSensitive = _caseCheckBox->isChecked();
-    Q_EMIT search(str, true, caseSensitive);
+    Q_EMIT search(str, true, flags());
 }
 
 
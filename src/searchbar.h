@@ -13,6 +13,8 @@
 
 #include <QWidget>
 
+#include "searchengine.h"
+
 class QCheckBox;
 class QLabel;
 class QLineEdit;
@@ -30,10 +32,13 @@ public:
 
     bool caseChecked();
 
+    // the options checked
+    SearchEngine::SearchFlags flags();
+
 Q_SIGNALS:
     void search(const QString &search,
                 bool forward = true,
-                bool casesensitive = false);
+                SearchEngine::SearchFlags flags = SearchEngine::SearchFlags());
 
 public Q_SLOTS:
     void searchMessage(const QString & msg);
@@ -46,6 +51,9 @@ private:
     QLineEdit* _findLineEdit;
 
     QCheckBox* _caseCheckBox;
+    QCheckBox* _wordsCheckBox;
+    QCheckBox* _diacriticsCheckBox;
+    QCheckBox* _regexCheckBox;
     QLabel* _notFoundLabel;
 };
 
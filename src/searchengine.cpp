@@ -0,0 +1,610 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "searchengine.h"
+
+#include "textscan.h"
+#include "tracing.h"
+
+#include <QtConcurrent>
+
+#include <QSet>
+
+#include <QPdfDocument>
+#include <QPdfSelection>
+
+#include <algorithm>
+#include <climits>
+
+
+// pages extracted by each worker job
+static const int PAGES_PER_CHUNK = 16;
+
+// pages scanned by each worker job
+static const int PAGES_PER_SCAN = 64;
+
+
+struct ChunkJob
+{
+    QPdfDocument* document;
+    int firstPage;
+    int lastPage;
+    QSharedPointer<QAtomicInt> cancelled;
+};
+
+
+struct ScanJob
+{
+    QVector<int> pages;
+    QVector<QString> texts;
+    QVector<QString> foldedTexts;
+    QString text;
+    SearchEngine::SearchFlags flags;
+    QSharedPointer<QAtomicInt> cancelled;
+};
+
+
+// splits folded text in words
+static QStringList splitWords(const QString &text)
+{
+    QStringList words;
+    QString word;
+    for (const QChar c : text) {
+        if (c.isLetterOrNumber()) {
+            word += c;
+            continue;
+        }
+        if (!word.isEmpty()) {
+            words.append(word);
+            word.clear();
+        }
+    }
+    if (!word.isEmpty()) {
+        words.append(word);
+    }
+    return words;
+}
+
+
+static PageTextChunk extractChunk(const ChunkJob &job)
+{
+    TRACE_SCOPE_ARG("search", "extract text", "first page", job.firstPage);
+
+    PageTextChunk chunk;
+    chunk.firstPage = job.firstPage;
+
+    for (int page = job.firstPage; page <= job.lastPage; ++page) {
+        if (job.cancelled->loadAcquire()) {
+            break;
+        }
+        const QString text = job.document->getAllText(page).text();
+        const QString folded = TextScan::fold(text, true, true);
+        chunk.texts.append(text);
+        chunk.foldedTexts.append(folded);
+
+        const QStringList words = splitWords(folded);
+        for (const QString &word : words) {
+            QVector<int> &pages = chunk.words[word];
+            if (pages.isEmpty() || pages.last() != page) {
+                pages.append(page);
+            }
+        }
+    }
+    return chunk;
+}
+
+
+// true if position is not inside a word
+static bool isWordBoundary(const QString &text, int position)
+{
+    return position <= 0 || position >= text.size()
+        || !text.at(position - 1).isLetterOrNumber() || !text.at(position).isLetterOrNumber();
+}
+
+
+static QVector<QVector<int> > scanJob(const ScanJob &job)
+{
+    TRACE_SCOPE_ARG("search", "scan pages", "first page", job.pages.first());
+
+    const SearchPattern pattern(job.text, job.flags);
+
+    QVector<QVector<int> > matches;
+    matches.reserve(job.pages.count());
+    for (int i = 0; i < job.pages.count(); ++i) {
+        if (job.cancelled->loadAcquire()) {
+            break;
+        }
+        matches.append( pattern.matches(job.texts.at(i), job.foldedTexts.at(i)) );
+    }
+    return matches;
+}
+
+
+// the pages where every query word is (part of) a word.
+// The first one may be the tail of a word and the last one its head,
+// the ones in the middle must match a whole word.
+static QSet<int> pagesWithTokens(const QHash<QString, QVector<int> > &words, const QStringList &tokens)
+{
+    QSet<int> pages;
+    for (int i = 0; i < tokens.count(); ++i) {
+        const QString &token = tokens.at(i);
+        const bool first = (i == 0);
+        const bool last = (i == tokens.count() - 1);
+
+        QSet<int> hits;
+        for (auto it = words.constBegin(); it != words.constEnd(); ++it) {
+            const QString &word = it.key();
+            bool match;
+            if (first && last) {
+                match = word.contains(token);
+            } else if (first) {
+                match = word.endsWith(token);
+            } else if (last) {
+                match = word.startsWith(token);
+            } else {
+                match = (word == token);
+            }
+            if (match) {
+                for (int page : it.value()) {
+                    hits.insert(page);
+                }
+            }
+        }
+
+        if (first) {
+            pages = hits;
+        } else {
+            pages.intersect(hits);
+        }
+        if (pages.isEmpty()) {
+            break;
+        }
+    }
+    return pages;
+}
+
+
+SearchPattern::SearchPattern(const QString &text, SearchEngine::SearchFlags flags)
+    : _text(text)
+    , _flags(flags)
+{
+    const bool caseFold = !(flags & SearchEngine::CaseSensitive);
+    const bool stripDiacritics = flags & SearchEngine::IgnoreDiacritics;
+
+    if (flags & SearchEngine::RegularExpression) {
+        // the pattern is matched against the text with no accents
+        QString pattern = stripDiacritics ? TextScan::fold(text, false, true) : text;
+        if (flags & SearchEngine::WholeWords) {
+            pattern = QLatin1String("\\b(?:") + pattern + QLatin1String(")\\b");
+        }
+        QRegularExpression::PatternOptions options = QRegularExpression::UseUnicodePropertiesOption;
+        if (caseFold) {
+            options |= QRegularExpression::CaseInsensitiveOption;
+        }
+        _regex = QRegularExpression(pattern, options);
+        return;
+    }
+
+    const bool exact = !caseFold && !stripDiacritics;
+    _pattern = exact ? text : TextScan::fold(text, true, true);
+    _compared = TextScan::fold(text, caseFold, stripDiacritics);
+}
+
+
+bool SearchPattern::isValid() const
+{
+    return !(_flags & SearchEngine::RegularExpression) || _regex.isValid();
+}
+
+
+QString SearchPattern::errorString() const
+{
+    return isValid() ? QString() : _regex.errorString();
+}
+
+
+bool SearchPattern::usesFoldedText() const
+{
+    return !(_flags & SearchEngine::RegularExpression)
+        && (!(_flags & SearchEngine::CaseSensitive) || (_flags & SearchEngine::IgnoreDiacritics));
+}
+
+
+QVector<int> SearchPattern::matches(const QString &text, const QString &folded) const
+{
+    QVector<int> offsets;
+
+    if (_flags & SearchEngine::RegularExpression) {
+        const QString subject = (_flags & SearchEngine::IgnoreDiacritics) ? TextScan::fold(text, false, true) : text;
+        QRegularExpressionMatchIterator it = _regex.globalMatch(subject);
+        while (it.hasNext()) {
+            const QRegularExpressionMatch match = it.next();
+            if (match.capturedLength() > 0) {
+                offsets.append( match.capturedStart() );
+            }
+        }
+        return offsets;
+    }
+
+    const bool caseFold = !(_flags & SearchEngine::CaseSensitive);
+    const bool stripDiacritics = _flags & SearchEngine::IgnoreDiacritics;
+    const bool exact = !caseFold && !stripDiacritics;
+    const QString &scanned = exact ? text : folded;
+    const int length = _text.size();
+
+    for (int offset = TextScan::indexOf(scanned, _pattern); offset >= 0;
+         offset = TextScan::indexOf(scanned, _pattern, offset + 1)) {
+        // the folded text matches more than asked: compare again
+        bool matches = true;
+        if (!exact && (!caseFold || !stripDiacritics)) {
+            for (int i = 0; i < length && matches; ++i) {
+                matches = TextScan::fold(text.at(offset + i), caseFold, stripDiacritics) == _compared.at(i);
+            }
+        }
+        if (matches && (_flags & SearchEngine::WholeWords)) {
+            matches = isWordBoundary(text, offset) && isWordBoundary(text, offset + length);
+        }
+        if (matches) {
+            offsets.append(offset);
+        }
+    }
+    return offsets;
+}
+
+
+SearchEngine::SearchEngine(QObject *parent)
+    : QObject(parent)
+    , _document(nullptr)
+    , _chunksRunning(0)
+    , _indexedCount(0)
+    , _forward(true)
+    , _pending(false)
+    , _matchPage(-1)
+    , _matchOffset(-1)
+    , _found(false)
+    , _matchCount(0)
+    , _scansRunning(0)
+{
+}
+
+
+SearchEngine::~SearchEngine()
+{
+    clear();
+
+    // the scans report to this object
+    _scanPool.waitForDone();
+}
+
+
+void SearchEngine::clear()
+{
+    if (_chunksRunning > 0) {
+        // workers use the document: wait for them before it goes away
+        _cancelled->storeRelease(1);
+        _extractPool.clear();
+        _extractPool.waitForDone();
+        _chunksRunning = 0;
+    }
+
+    stopSearch();
+
+    _document = nullptr;
+    _pageTexts.clear();
+    _foldedTexts.clear();
+    _pageIndexed.clear();
+    _indexedCount = 0;
+    _index.clear();
+}
+
+
+void SearchEngine::stopSearch()
+{
+    // the scans running work on copies of the text: they are left to end
+    if (_scanCancelled) {
+        _scanCancelled->storeRelease(1);
+        _scanCancelled.reset();
+    }
+
+    _query.clear();
+    _pending = false;
+    _matchPage = -1;
+    _found = false;
+    _pageMatches.clear();
+    _pageScanned.clear();
+    _matchCount = 0;
+    _scansRunning = 0;
+}
+
+
+void SearchEngine::setDocument(QPdfDocument *document)
+{
+    clear();
+
+    _document = document;
+    if (!_document || _document->pageCount() == 0) {
+        return;
+    }
+
+    const int pageCount = _document->pageCount();
+    _pageTexts.resize(pageCount);
+    _foldedTexts.resize(pageCount);
+    _pageIndexed.fill(false, pageCount);
+
+    _cancelled.reset(new QAtomicInt(0));
+
+    QVector<ChunkJob> jobs;
+    for (int first = 0; first < pageCount; first += PAGES_PER_CHUNK) {
+        ChunkJob job;
+        job.document = _document;
+        job.firstPage = first;
+        job.lastPage = qMin(first + PAGES_PER_CHUNK, pageCount) - 1;
+        job.cancelled = _cancelled;
+        jobs.append(job);
+    }
+
+    SearchEngine* engine = this;
+    for (const ChunkJob &job : qAsConst(jobs)) {
+        ++_chunksRunning;
+        QtConcurrent::run(&_extractPool, [=] () {
+                const PageTextChunk chunk = extractChunk(job);
+                const QSharedPointer<QAtomicInt> cancelled = job.cancelled;
+                QMetaObject::invokeMethod(engine, [=] () {
+                        // chunks of a document gone
+                        if (!cancelled->loadAcquire()) {
+                            engine->onChunkReady(chunk);
+                        }
+                    }, Qt::QueuedConnection
+                );
+            }
+        );
+    }
+}
+
+
+void SearchEngine::onChunkReady(const PageTextChunk &chunk)
+{
+    for (int i = 0; i < chunk.texts.count(); ++i) {
+        const int page = chunk.firstPage + i;
+        _pageTexts[page] = chunk.texts.at(i);
+        _foldedTexts[page] = chunk.foldedTexts.at(i);
+        _pageIndexed[page] = true;
+    }
+    _indexedCount += chunk.texts.count();
+
+    for (auto it = chunk.words.constBegin(); it != chunk.words.constEnd(); ++it) {
+        _index[it.key()] += it.value();
+    }
+
+    // the search going on looks at the new pages too
+    if (!_query.isEmpty() && !chunk.texts.isEmpty()) {
+        scanPages(chunk.firstPage, chunk.firstPage + chunk.texts.count() - 1, chunk.words);
+    }
+
+    if (_pending) {
+        findNext();
+    }
+
+    if (--_chunksRunning == 0) {
+        onIndexFinished();
+    }
+}
+
+
+void SearchEngine::onIndexFinished()
+{
+    Q_EMIT indexFinished();
+
+    if (!_query.isEmpty() && !isScanning()) {
+        Q_EMIT scanFinished(_matchCount);
+    }
+
+    if (_pending) {
+        findNext();
+    }
+}
+
+
+void SearchEngine::find(const QString &text, int fromPage, bool forward, SearchFlags flags)
+{
+    if (text.isEmpty() || _pageTexts.isEmpty()) {
+        return;
+    }
+
+    if (text != _query || flags != _flags) {
+        stopSearch();
+
+        const SearchPattern pattern(text, flags);
+        if (!pattern.isValid()) {
+            Q_EMIT message( tr("Invalid regular expression: %1").arg(pattern.errorString()) );
+            return;
+        }
+
+        _query = text;
+        _flags = flags;
+        _pageMatches.resize(_pageTexts.count());
+        _pageScanned.fill(false, _pageTexts.count());
+        _scanCancelled.reset(new QAtomicInt(0));
+        scanPages(0, _pageTexts.count() - 1, _index);
+
+        if (!isScanning() && !isIndexing()) {
+            Q_EMIT scanFinished(_matchCount);
+        }
+    }
+
+    if (fromPage != _matchPage) {
+        // start from the visible page: before its first char going forward,
+        // after its last one going backward
+        _matchPage = qBound(0, fromPage, _pageTexts.count() - 1);
+        _matchOffset = forward ? -1 : INT_MAX;
+        _found = false;
+    }
+
+    _forward = forward;
+    findNext();
+}
+
+
+void SearchEngine::scanPages(int first, int last, const QHash<QString, QVector<int> > &words)
+{
+    // the index tells the pages worth scanning, when the query has words
+    const QStringList tokens = (_flags & RegularExpression) ? QStringList() : splitWords( TextScan::fold(_query, true, true) );
+    const QSet<int> candidates = tokens.isEmpty() ? QSet<int>() : pagesWithTokens(words, tokens);
+
+    QVector<ScanJob> jobs;
+    for (int page = first; page <= last; ++page) {
+        if (!_pageIndexed.at(page)) {
+            continue;
+        }
+        if (!tokens.isEmpty() && !candidates.contains(page)) {
+            _pageScanned[page] = true;
+            continue;
+        }
+
+        if (jobs.isEmpty() || jobs.last().pages.count() == PAGES_PER_SCAN) {
+            ScanJob job;
+            job.text = _query;
+            job.flags = _flags;
+            job.cancelled = _scanCancelled;
+            jobs.append(job);
+        }
+        // the texts are implicitly shared: jobs get a snapshot of them
+        ScanJob &job = jobs.last();
+        job.pages.append(page);
+        job.texts.append( _pageTexts.at(page) );
+        job.foldedTexts.append( _foldedTexts.at(page) );
+    }
+
+    SearchEngine* engine = this;
+    for (const ScanJob &job : qAsConst(jobs)) {
+        ++_scansRunning;
+        QtConcurrent::run(&_scanPool, [=] () {
+                const QVector<QVector<int> > matches = scanJob(job);
+                const QSharedPointer<QAtomicInt> cancelled = job.cancelled;
+                const QVector<int> pages = job.pages;
+                QMetaObject::invokeMethod(engine, [=] () {
+                        // results of a search given up
+                        if (!cancelled->loadAcquire()) {
+                            engine->onPagesScanned(pages, matches);
+                        }
+                    }, Qt::QueuedConnection
+                );
+            }
+        );
+    }
+}
+
+
+void SearchEngine::onPagesScanned(const QVector<int> &pages, const QVector<QVector<int> > &matches)
+{
+    for (int i = 0; i < pages.count(); ++i) {
+        const int page = pages.at(i);
+        _pageMatches[page] = matches.at(i);
+        _pageScanned[page] = true;
+        _matchCount += matches.at(i).count();
+    }
+    --_scansRunning;
+
+    if (_pending) {
+        findNext();
+    }
+
+    if (!isScanning() && !isIndexing()) {
+        // the number of matches is known now
+        if (_found && !_pending) {
+            reportMatch();
+        }
+        Q_EMIT scanFinished(_matchCount);
+    }
+}
+
+
+int SearchEngine::matchNumber(int page, int offset) const
+{
+    int number = 0;
+    for (int i = 0; i < page; ++i) {
+        number += _pageMatches.at(i).count();
+    }
+    const QVector<int> &offsets = _pageMatches.at(page);
+    return number + int(std::lower_bound(offsets.constBegin(), offsets.constEnd(), offset) - offsets.constBegin()) + 1;
+}
+
+
+void SearchEngine::reportMatch()
+{
+    QString msg = tr("Found on page %1").arg(_matchPage + 1);
+    if (isIndexing()) {
+        msg += QLatin1String(" ") + tr("(%1 of %2 pages indexed)").arg(_indexedCount).arg(_pageTexts.count());
+    } else if (!isScanning()) {
+        msg += QLatin1String(" ") + tr("(match %1 of %2)").arg(matchNumber(_matchPage, _matchOffset)).arg(_matchCount);
+    }
+    Q_EMIT message(msg);
+}
+
+
+void SearchEngine::findNext()
+{
+    TRACE_SCOPE("search", "find");
+
+    _pending = false;
+    const int pageCount = _pageTexts.count();
+
+    // the rest of the page of the last match, the other pages in search
+    // order, then the page of the last match again, wrapping around
+    for (int i = 0; i <= pageCount; ++i) {
+        const int page = _forward ? (_matchPage + i) % pageCount
+                                  : (_matchPage - i + pageCount) % pageCount;
+
+        // pages not extracted yet are looked at when they are
+        if (!_pageIndexed.at(page)) {
+            continue;
+        }
+
+        // matches are found in order: wait for the scan of this page
+        if (!_pageScanned.at(page)) {
+            _pending = true;
+            Q_EMIT message( tr("Searching...") );
+            return;
+        }
+
+        const QVector<int> &offsets = _pageMatches.at(page);
+        if (offsets.isEmpty()) {
+            continue;
+        }
+
+        int offset = -1;
+        if (i > 0) {
+            offset = _forward ? offsets.first() : offsets.last();
+        } else if (_forward) {
+            const auto next = std::upper_bound(offsets.constBegin(), offsets.constEnd(), _matchOffset);
+            offset = next != offsets.constEnd() ? *next : -1;
+        } else {
+            const auto next = std::lower_bound(offsets.constBegin(), offsets.constEnd(), _matchOffset);
+            offset = next != offsets.constBegin() ? *(next - 1) : -1;
+        }
+
+        if (offset >= 0) {
+            _matchPage = page;
+            _matchOffset = offset;
+            _found = true;
+            Q_EMIT matchFound(page, offset);
+            reportMatch();
+            return;
+        }
+    }
+
+    if (isIndexing()) {
+        // look again when more pages are indexed
+        _pending = true;
+        Q_EMIT message( tr("Searching... (%1 of %2 pages indexed)").arg(_indexedCount).arg(_pageTexts.count()) );
+        return;
+    }
+
+    Q_EMIT message( tr("Not found") );
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef SEARCHENGINE_H
+#define SEARCHENGINE_H
+
+
+#include <QAtomicInt>
+#include <QHash>
+#include <QObject>
+#include <QRegularExpression>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVector>
+
+class QPdfDocument;
+
+
+// The text of a run of pages, case and diacritics folded too, with the
+// (folded) words found in it
+struct PageTextChunk
+{
+    int firstPage = 0;
+    QVector<QString> texts;
+    QVector<QString> foldedTexts;
+    QHash<QString, QVector<int> > words;
+};
+
+
+// Per document full-text search.
+// Page text is extracted by a worker pool of its own as soon as the document
+// is set (a long extraction does not hold the global pool),
+// and kept together with an inverted index (word -> pages) used to pick the
+// pages worth scanning. A new search scans the indexed pages on worker
+// threads, a run of pages per job, and the pages extracted later as they
+// arrive: matches are walked in page order, whatever job ends first.
+// A search with no result while indexing is still running is resumed as
+// new pages arrive.
+class SearchEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum SearchFlag {
+        CaseSensitive = 0x1,
+        WholeWords = 0x2,
+        IgnoreDiacritics = 0x4,
+        RegularExpression = 0x8
+    };
+    Q_DECLARE_FLAGS(SearchFlags, SearchFlag)
+
+    explicit SearchEngine(QObject *parent = nullptr);
+    ~SearchEngine();
+
+    void setDocument(QPdfDocument *document);
+    void clear();
+
+    inline bool isIndexing() const { return _chunksRunning > 0; }
+    inline int indexedPages() const { return _indexedCount; }
+
+    // looks for the next (or previous) match, starting from fromPage
+    // or from the last match, if the search is going on there
+    void find(const QString &text, int fromPage, bool forward, SearchFlags flags);
+
+    // forgets the search going on, and stops its scans
+    void stopSearch();
+    inline bool isScanning() const { return _scansRunning > 0; }
+
+Q_SIGNALS:
+    void indexFinished();
+    void matchFound(int page, int offset);
+    // every indexed page was scanned for the search going on
+    void scanFinished(int matchCount);
+    void message(const QString &msg);
+
+private:
+    void onChunkReady(const PageTextChunk &chunk);
+    void onIndexFinished();
+    void findNext();
+    // scans the indexed pages from first to last, not scanned yet
+    void scanPages(int first, int last, const QHash<QString, QVector<int> > &words);
+    void onPagesScanned(const QVector<int> &pages, const QVector<QVector<int> > &matches);
+    void reportMatch();
+    // counting from 1, in page order
+    int matchNumber(int page, int offset) const;
+
+private:
+    QPdfDocument* _document;
+    int _chunksRunning;
+    QSharedPointer<QAtomicInt> _cancelled;
+    QThreadPool _extractPool;
+
+    QVector<QString> _pageTexts;
+    QVector<QString> _foldedTexts;
+    QVector<bool> _pageIndexed;
+    int _indexedCount;
+    QHash<QString, QVector<int> > _index;
+
+    // the search going on
+    QString _query;
+    SearchFlags _flags;
+    bool _forward;
+    bool _pending;
+    int _matchPage;
+    int _matchOffset;
+    bool _found;
+
+    // the offsets of the matches on each page, once scanned
+    QVector<QVector<int> > _pageMatches;
+    QVector<bool> _pageScanned;
+    int _matchCount;
+    int _scansRunning;
+    QSharedPointer<QAtomicInt> _scanCancelled;
+    QThreadPool _scanPool;
+};
+
+Q_DECLARE_OPERATORS_FOR_FLAGS(SearchEngine::SearchFlags)
+
+
+// What a search looks for, prepared once for the pages it scans.
+// Each worker thread builds a pattern of its own.
+class SearchPattern
+{
+public:
+    SearchPattern(const QString &text, SearchEngine::SearchFlags flags);
+
+    // false for an invalid regular expression
+    bool isValid() const;
+    QString errorString() const;
+
+    // false when matches() does not look at the folded text
+    bool usesFoldedText() const;
+
+    // the offsets of the matches in the text of a page, given folded
+    // by TextScan::fold(text, true, true) too
+    QVector<int> matches(const QString &text, const QString &folded) const;
+
+private:
+    QString _text;
+    SearchEngine::SearchFlags _flags;
+
+    // scanned for: in the text when exact, in the folded text otherwise
+    QString _pattern;
+    // the text folded as flags say, to check what the folded scan found
+    QString _compared;
+
+    QRegularExpression _regex;
+};
+
+#endif // SEARCHENGINE_H
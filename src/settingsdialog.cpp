@@ -10,21 +10,28 @@
 #include "settingsdialog.h"
 #include "ui_settings.h"
 
+#include "application.h"
+#include "settingsstore.h"
+#include "tracing.h"
+
 #include <QColorDialog>
 #include <QDebug>
 #include <QFontDialog>
 #include <QMessageBox>
-#include <QSettings>
 
 
 SettingsDialog::SettingsDialog(QWidget *parent) 
     : QDialog(parent)
     , ui(new Ui::Dialog)
+    , _loading(false)
 {
     ui->setupUi(this);
     setWindowTitle( tr("Cutepad Settings") );
 
     ui->spacesSpinBox->setRange(1,12);
+    ui->cacheSizeSpinBox->setRange(16,4096);
+    ui->diskCacheSizeSpinBox->setRange(0,65536);
+    ui->memoryBudgetSpinBox->setRange(0,65536);
         
     connect(ui->lineColorButton, &QPushButton::clicked, this, &SettingsDialog::chooseHighlightColor);
     connect(ui->fontButton, &QPushButton::clicked, this, &SettingsDialog::chooseFont);
@@ -37,6 +44,13 @@ SettingsDialog::SettingsDialog(QWidget *parent)
 
     connect(ui->replaceTabsWithSpacesCheckBox, &QCheckBox::stateChanged, this, &SettingsDialog::saveSettings);
     connect(ui->spacesSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, &SettingsDialog::saveSettings);
+
+    connect(ui->cacheSizeSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, &SettingsDialog::saveSettings);
+    connect(ui->diskCacheSizeSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, &SettingsDialog::saveSettings);
+    connect(ui->memoryBudgetSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, &SettingsDialog::saveSettings);
+    connect(ui->memoryMappedCheckBox, &QCheckBox::stateChanged, this, &SettingsDialog::saveSettings);
+    connect(ui->autoReloadCheckBox, &QCheckBox::stateChanged, this, &SettingsDialog::saveSettings);
+    connect(ui->diagnosticsCheckBox, &QCheckBox::stateChanged, this, &SettingsDialog::saveSettings);
 }
 
 
@@ -48,61 +62,112 @@ SettingsDialog::~SettingsDialog()
 
 void SettingsDialog::loadSettings()
 {
+    TRACE_SCOPE("settings", "load settings dialog");
+
+    _loading = true;
+
     // the settings object
-    QSettings s;
+    SettingsStore* s = Application::instance()->settings();
 
-    int lineNumbersMode = s.value( QStringLiteral("LineNumbers") , 0).toInt();
+    int lineNumbersMode = s->value( QStringLiteral("LineNumbers") , 0).toInt();
     ui->lineNumbersComboBox->setCurrentIndex(lineNumbersMode);
 
-    bool highlight = s.value( QStringLiteral("CurrentLineHighlight") , false).toBool();
+    bool highlight = s->value( QStringLiteral("CurrentLineHighlight") , false).toBool();
     ui->highlightCurrentLineCheckBox->setChecked(highlight);
 
-    QColor highlightLineColor = s.value( QStringLiteral("HighlightLineColor") , QColor(Qt::yellow).lighter(160)).value<QColor>();
+    QColor highlightLineColor = s->value( QStringLiteral("HighlightLineColor") , QColor(Qt::yellow).lighter(160)).value<QColor>();
     QPalette p = ui->lineColorButton->palette();
     p.setColor(QPalette::Button, highlightLineColor);
     ui->lineColorButton->setPalette(p);
     ui->lineColorButton->setEnabled(highlight);
 
-    bool tabReplace = s.value( QStringLiteral("TabReplace"), false).toBool();
+    bool tabReplace = s->value( QStringLiteral("TabReplace"), false).toBool();
     ui->replaceTabsWithSpacesCheckBox->setChecked(tabReplace);
 
-    int tabsCount = s.value( QStringLiteral("TabsCount"), 4).toInt();
+    int tabsCount = s->value( QStringLiteral("TabsCount"), 4).toInt();
     ui->spacesSpinBox->setValue(tabsCount);
+
+    int cacheSize = s->value( QStringLiteral("RenderCacheSize"), 256).toInt();
+    ui->cacheSizeSpinBox->setValue(cacheSize);
+
+    int diskCacheSize = s->value( QStringLiteral("DiskCacheSize"), 1024).toInt();
+    ui->diskCacheSizeSpinBox->setValue(diskCacheSize);
+
+    int memoryBudget = s->value( QStringLiteral("MemoryBudget"), 0).toInt();
+    ui->memoryBudgetSpinBox->setValue(memoryBudget);
+
+    bool memoryMapped = s->value( QStringLiteral("MemoryMappedFiles"), true).toBool();
+    ui->memoryMappedCheckBox->setChecked(memoryMapped);
+
+    bool autoReload = s->value( QStringLiteral("AutoReload"), true).toBool();
+    ui->autoReloadCheckBox->setChecked(autoReload);
+
+    bool showDiagnostics = s->value( QStringLiteral("ShowDiagnostics"), false).toBool();
+    ui->diagnosticsCheckBox->setChecked(showDiagnostics);
     
     // font
-    QString fontFamily = s.value( QStringLiteral("fontFamily") , QStringLiteral("Monospace") ).toString();
-    int fontSize = s.value( QStringLiteral("fontSize") , 12).toInt();
-    int fontWeight = s.value( QStringLiteral("fontWeight"), 50).toInt();
-    bool italic = s.value( QStringLiteral("fontItalic"), false).toBool();
+    QString fontFamily = s->value( QStringLiteral("fontFamily") , QStringLiteral("Monospace") ).toString();
+    int fontSize = s->value( QStringLiteral("fontSize") , 12).toInt();
+    int fontWeight = s->value( QStringLiteral("fontWeight"), 50).toInt();
+    bool italic = s->value( QStringLiteral("fontItalic"), false).toBool();
     QFont font(fontFamily,fontSize, fontWeight);
     font.setItalic(italic);
     QString fontName = fontFamily + QLatin1String(", ") + QString::number(fontSize) + QLatin1String("pt");
     ui->fontLabel->setText(fontName);
     ui->fontLabel->setFont(font);
+
+    _loading = false;
 }
 
 
 void SettingsDialog::saveSettings()
 {
+    if (_loading) {
+        return;
+    }
+
+    TRACE_SCOPE("settings", "save settings");
+
     // the settings object
-    QSettings s;
+    SettingsStore* s = Application::instance()->settings();
+
+    // observers get every change at once
+    s->beginTransaction();
 
     int lineNumbersMode = ui->lineNumbersComboBox->currentIndex();
-    s.setValue( QStringLiteral("LineNumbers") , lineNumbersMode);
+    s->setValue( QStringLiteral("LineNumbers") , lineNumbersMode);
 
     bool highlight = ui->highlightCurrentLineCheckBox->isChecked();
-    s.setValue( QStringLiteral("CurrentLineHighlight"), highlight);
+    s->setValue( QStringLiteral("CurrentLineHighlight"), highlight);
     ui->lineColorButton->setEnabled(highlight);
     
     QPalette p = ui->lineColorButton->palette();
     QColor highlightLineColor = p.color(QPalette::Button);
-    s.setValue( QStringLiteral("HighlightLineColor") , highlightLineColor);
+    s->setValue( QStringLiteral("HighlightLineColor") , highlightLineColor);
     
     bool tabReplace = ui->replaceTabsWithSpacesCheckBox->isChecked();
-    s.setValue( QStringLiteral("TabReplace") , tabReplace);
+    s->setValue( QStringLiteral("TabReplace") , tabReplace);
     
     int tabsCount = ui->spacesSpinBox->value();
-    s.setValue( QStringLiteral("TabsCount") , tabsCount);
+    s->setValue( QStringLiteral("TabsCount") , tabsCount);
+
+    int cacheSize = ui->cacheSizeSpinBox->value();
+    s->setValue( QStringLiteral("RenderCacheSize") , cacheSize);
+
+    int diskCacheSize = ui->diskCacheSizeSpinBox->value();
+    s->setValue( QStringLiteral("DiskCacheSize") , diskCacheSize);
+
+    int memoryBudget = ui->memoryBudgetSpinBox->value();
+    s->setValue( QStringLiteral("MemoryBudget") , memoryBudget);
+
+    bool memoryMapped = ui->memoryMappedCheckBox->isChecked();
+    s->setValue( QStringLiteral("MemoryMappedFiles") , memoryMapped);
+
+    bool autoReload = ui->autoReloadCheckBox->isChecked();
+    s->setValue( QStringLiteral("AutoReload") , autoReload);
+
+    bool showDiagnostics = ui->diagnosticsCheckBox->isChecked();
+    s->setValue( QStringLiteral("ShowDiagnostics") , showDiagnostics);
 
     // font
     QFont f = ui->fontLabel->font();
@@ -110,10 +175,12 @@ void SettingsDialog::saveSettings()
     int fontSize = f.pointSize();
     int fontWeight = f.weight();
     bool italic = f.italic();
-    s.setValue( QStringLiteral("fontFamily") , fontFamily);
-    s.setValue( QStringLiteral("fontSize")   , fontSize);
-    s.setValue( QStringLiteral("fontWeight") , fontWeight);
-    s.setValue( QStringLiteral("fontItalic") , italic);
+    s->setValue( QStringLiteral("fontFamily") , fontFamily);
+    s->setValue( QStringLiteral("fontSize")   , fontSize);
+    s->setValue( QStringLiteral("fontWeight") , fontWeight);
+    s->setValue( QStringLiteral("fontItalic") , italic);
+
+    s->commit();
 }
 
 
@@ -160,11 +227,13 @@ void SettingsDialog::resetSettings()
     switch(risp) {
         case QMessageBox::Reset: {
 
-            // the settings object
-            QSettings s;
-            s.clear();
-            s.sync();
+            // the cleared keys are notified once; the widgets then show
+            // the defaults, without writing them back
+            SettingsStore* s = Application::instance()->settings();
+            s->beginTransaction();
+            s->clear();
             loadSettings();
+            s->commit();
             break;
         }
         case QMessageBox::Cancel:
@@ -36,6 +36,9 @@ private Q_SLOTS:
 
 private:
     Ui::Dialog *ui;
+
+    // the widgets are being set from the settings: nothing to save
+    bool _loading;
 };
 
 #endif // SETTINGSDIALOG_H
@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "settingsstore.h"
+
+#include "tracing.h"
+
+#include <QtConcurrent>
+
+#include <QSettings>
+#include <QTimer>
+
+
+static void writeSettings(bool cleared, const QHash<QString, QVariant> &changes)
+{
+    TRACE_SCOPE_ARG("settings", "write settings", "keys", changes.count());
+
+    QSettings s;
+    if (cleared) {
+        s.clear();
+    }
+    for (auto it = changes.constBegin(); it != changes.constEnd(); ++it) {
+        if (it.value().isValid()) {
+            s.setValue(it.key(), it.value());
+        } else {
+            s.remove(it.key());
+        }
+    }
+    s.sync();
+}
+
+
+SettingsStore::SettingsStore(QObject *parent)
+    : QObject(parent)
+    , _cleared(false)
+    , _transactions(0)
+    , _flushTimer(new QTimer(this))
+{
+    TRACE_SCOPE("settings", "read settings");
+
+    // read once: QSettings is not touched again but to write
+    QSettings s;
+    const QStringList keys = s.allKeys();
+    for (const QString &key : keys) {
+        _values.insert(key, s.value(key));
+    }
+
+    _writer.setMaxThreadCount(1);
+
+    _flushTimer->setSingleShot(true);
+    _flushTimer->setInterval(FLUSH_DELAY);
+    connect(_flushTimer, &QTimer::timeout, this, &SettingsStore::flush);
+}
+
+
+SettingsStore::~SettingsStore()
+{
+    sync();
+}
+
+
+QVariant SettingsStore::value(const QString &key, const QVariant &defaultValue) const
+{
+    return _values.value(key, defaultValue);
+}
+
+
+void SettingsStore::setValue(const QString &key, const QVariant &value)
+{
+    const auto it = _values.constFind(key);
+    if (it != _values.constEnd() && it.value() == value) {
+        return;
+    }
+
+    _values.insert(key, value);
+    _pending.insert(key, value);
+    markChanged(key);
+}
+
+
+void SettingsStore::remove(const QString &key)
+{
+    if (!_values.remove(key)) {
+        return;
+    }
+
+    _pending.insert(key, QVariant());
+    markChanged(key);
+}
+
+
+void SettingsStore::clear()
+{
+    beginTransaction();
+
+    const QStringList keys = _values.keys();
+    _values.clear();
+    _pending.clear();
+    _cleared = true;
+    for (const QString &key : keys) {
+        markChanged(key);
+    }
+
+    commit();
+}
+
+
+void SettingsStore::beginTransaction()
+{
+    ++_transactions;
+}
+
+
+void SettingsStore::commit()
+{
+    Q_ASSERT(_transactions > 0);
+    if (--_transactions > 0 || _changedKeys.isEmpty()) {
+        return;
+    }
+
+    const QStringList keys = _changedKeys;
+    _changedKeys.clear();
+    for (const QString &key : keys) {
+        Q_EMIT valueChanged(key);
+    }
+    Q_EMIT changed(keys);
+}
+
+
+void SettingsStore::markChanged(const QString &key)
+{
+    // a burst of changes is written once, when it is over
+    _flushTimer->start();
+
+    if (_transactions > 0) {
+        if (!_changedKeys.contains(key)) {
+            _changedKeys.append(key);
+        }
+        return;
+    }
+
+    Q_EMIT valueChanged(key);
+    Q_EMIT changed( QStringList(key) );
+}
+
+
+void SettingsStore::flush()
+{
+    _flushTimer->stop();
+    if (_pending.isEmpty() && !_cleared) {
+        return;
+    }
+
+    // the writer gets its own copy: changes go on in the meantime
+    QtConcurrent::run(&_writer, writeSettings, _cleared, _pending);
+    _pending.clear();
+    _cleared = false;
+}
+
+
+void SettingsStore::sync()
+{
+    flush();
+    _writer.waitForDone();
+}
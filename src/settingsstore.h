@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef SETTINGSSTORE_H
+#define SETTINGSSTORE_H
+
+
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVariant>
+
+class QTimer;
+
+
+// The application settings, kept in memory.
+// Reads never touch the disk. Changes are notified at once, key by key,
+// and written to QSettings later, all together, from a background thread.
+// Changes made between beginTransaction() and commit() are notified
+// once, when the transaction ends.
+class SettingsStore : public QObject
+{
+    Q_OBJECT
+
+public:
+    // how long changes wait for the next ones, before being written
+    static const int FLUSH_DELAY = 1000;
+
+    explicit SettingsStore(QObject *parent = nullptr);
+
+    // writes what is still pending
+    ~SettingsStore();
+
+    QVariant value(const QString &key, const QVariant &defaultValue = QVariant()) const;
+
+    // setting a key to its current value changes nothing
+    void setValue(const QString &key, const QVariant &value);
+    void remove(const QString &key);
+
+    // back to the defaults, for every key
+    void clear();
+
+    // transactions can be nested: the outermost commit notifies
+    void beginTransaction();
+    void commit();
+
+    // writes the pending changes now, and waits for them
+    void sync();
+
+Q_SIGNALS:
+    void valueChanged(const QString &key);
+
+    // once per transaction, with every key changed
+    void changed(const QStringList &keys);
+
+private Q_SLOTS:
+    void flush();
+
+private:
+    void markChanged(const QString &key);
+
+private:
+    QHash<QString, QVariant> _values;
+
+    // waiting to be written: the removed keys have an invalid value
+    QHash<QString, QVariant> _pending;
+    bool _cleared;
+
+    int _transactions;
+    QStringList _changedKeys;
+
+    QTimer* _flushTimer;
+
+    // writes, in order, one at a time
+    QThreadPool _writer;
+};
+
+#endif // SETTINGSSTORE_H
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "startuptrace.h"
+
+#include <QElapsedTimer>
+#include <QPair>
+#include <QTextStream>
+#include <QVector>
+
+#ifdef Q_OS_LINUX
+#include <QFile>
+#include <QStringList>
+#include <unistd.h>
+#endif
+
+
+namespace
+{
+    // started during static initialization, right after the program is loaded
+    struct Clock
+    {
+        Clock() { timer.start(); }
+        QElapsedTimer timer;
+    };
+
+    Clock startupClock;
+
+    bool enabled = !qEnvironmentVariableIsEmpty("CUTEVIEWER_STARTUP_TRACE");
+    bool reported = false;
+    QVector<QPair<QString, qint64> > milestones;
+}
+
+
+#ifdef Q_OS_LINUX
+// the time spent by the kernel and the dynamic linker before our clock started
+static qint64 loadTimeNsecs()
+{
+    QFile stat( QStringLiteral("/proc/self/stat") );
+    QFile uptime( QStringLiteral("/proc/uptime") );
+    if (!stat.open(QIODevice::ReadOnly) || !uptime.open(QIODevice::ReadOnly)) {
+        return 0;
+    }
+
+    // process start time is the 22nd field, in clock ticks since boot.
+    // The 2nd one (the command) may contain spaces: count after it
+    const QString statLine = QString::fromLatin1( stat.readAll() );
+    const QStringList fields = statLine.mid( statLine.lastIndexOf(QLatin1Char(')')) + 2 ).split(QLatin1Char(' '));
+    if (fields.count() < 20) {
+        return 0;
+    }
+    const double startSecs = fields.at(19).toDouble() / sysconf(_SC_CLK_TCK);
+    const double nowSecs = QString::fromLatin1( uptime.readAll() ).section(QLatin1Char(' '), 0, 0).toDouble();
+    const qint64 sinceStart = qint64((nowSecs - startSecs) * 1e9);
+
+    return qMax(qint64(0), sinceStart - startupClock.timer.nsecsElapsed());
+}
+#else
+static qint64 loadTimeNsecs()
+{
+    return 0;
+}
+#endif
+
+
+void StartupTrace::setEnabled(bool on)
+{
+    enabled = on;
+}
+
+
+bool StartupTrace::isEnabled()
+{
+    return enabled;
+}
+
+
+void StartupTrace::mark(const QString &milestone)
+{
+    if (reported) {
+        return;
+    }
+    for (const auto &m : qAsConst(milestones)) {
+        if (m.first == milestone) {
+            return;
+        }
+    }
+    milestones.append( qMakePair(milestone, startupClock.timer.nsecsElapsed()) );
+}
+
+
+void StartupTrace::report()
+{
+    if (reported || !enabled) {
+        return;
+    }
+    reported = true;
+
+    // the clock resolution of /proc is coarse (ticks): the load
+    // time is an estimate, the rest is precise
+    const qint64 offset = loadTimeNsecs();
+
+    QTextStream err(stderr);
+    err << "startup trace (ms since process start):" << Qt::endl;
+    err << QStringLiteral("%1  process loaded").arg(offset / 1e6, 9, 'f', 1) << Qt::endl;
+    for (const auto &m : qAsConst(milestones)) {
+        err << QStringLiteral("%1  %2").arg((offset + m.second) / 1e6, 9, 'f', 1).arg(m.first) << Qt::endl;
+    }
+}
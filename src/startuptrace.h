@@ -0,0 +1,34 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef STARTUPTRACE_H
+#define STARTUPTRACE_H
+
+
+#include <QString>
+
+
+// The startup timeline: when the main milestones (QApplication created,
+// first window shown, first page painted...) are reached, counting from
+// process start. Milestones are always recorded, it costs nothing;
+// the timeline is printed on stderr only when the trace is enabled
+// (CUTEVIEWER_STARTUP_TRACE environment variable or --startup-trace).
+namespace StartupTrace
+{
+    void setEnabled(bool on);
+    bool isEnabled();
+
+    // records milestone, the first time it is reached
+    void mark(const QString &milestone);
+
+    // prints the timeline, once
+    void report();
+}
+
+#endif // STARTUPTRACE_H
@@ -15,55 +15,63 @@
 
 StatusBar::StatusBar(QWidget *parent)
     : QWidget(parent)
-    , _langLabel(new QLabel(this))
-    , _posLabel(new QLabel(this))
-    , _codecLabel(new QLabel(this))
+    , _pageLabel(new QLabel(this))
     , _zoomLabel(new QLabel(this))
+    , _diagnosticsLabel(new QLabel(this))
 {
     // The UI
     auto layout = new QHBoxLayout;
     layout->setContentsMargins (0, 0, 0, 0);
-    layout->addWidget (_posLabel);
-    layout->addWidget (_langLabel);
-    layout->addWidget (_codecLabel);
+    layout->addWidget (_pageLabel);
     layout->addWidget (_zoomLabel);
+    layout->addWidget (_diagnosticsLabel);
     setLayout (layout);
+
+    _diagnosticsLabel->hide();
 }
 
 
-void StatusBar::setLanguage(const QString& lang)
+void StatusBar::setPage(int page, int pageCount)
 {
+    if (pageCount <= 0) {
+        _pageLabel->clear();
+        return;
+    }
+
     QString msg;
-    msg += QLatin1String("&nbsp;&nbsp;<b>") + tr("Language") + QLatin1String(": </b>");
-    msg += lang;
-    _langLabel->setText(msg);
+    msg += QLatin1String("&nbsp;&nbsp;<b>") + tr("Page") + QLatin1String(": </b>");
+    msg += tr("%1 of %2").arg(page + 1).arg(pageCount);
+    _pageLabel->setText(msg);
 }
 
 
-void StatusBar::setPosition(int row, int col)
+void StatusBar::setZoom(const QString& zoom)
 {
     QString msg;
-    msg += QLatin1String("&nbsp;&nbsp;<b>") + tr("Row") + QLatin1String(": </b>");
-    msg += QString::number(row + 1);
-    msg += QLatin1String(", <b>") + tr("Column") + QLatin1String(": </b>");
-    msg += QString::number(col + 1);
-    _posLabel->setText(msg);
+    msg += QLatin1String("&nbsp;&nbsp;<b>") + tr("Zoom") + QLatin1String(": </b>");
+    msg += zoom;
+    _zoomLabel->setText(msg);
 }
 
 
-void StatusBar::setCodec(const QString& codec)
+void StatusBar::setDiagnosticsVisible(bool visible)
 {
-    QString msg;
-    msg += QLatin1String("&nbsp;&nbsp;<b>") + tr("Encoding") + QLatin1String(": </b>");
-    msg += codec;
-    _codecLabel->setText(msg);
+    _diagnosticsLabel->setVisible(visible);
 }
 
 
-void StatusBar::setZoom(const QString& zoom)
+void StatusBar::setDiagnostics(qint64 renderTime, qreal hitRate, qint64 cacheBytes, int pendingRenders, qint64 rss)
 {
+    const QLatin1String unknown("-");
+
     QString msg;
-    msg += QLatin1String("&nbsp;&nbsp;<b>") + tr("Zoom") + QLatin1String(": </b>");
-    msg += zoom;
-    _zoomLabel->setText(msg);
+    msg += QLatin1String("&nbsp;&nbsp;<b>") + tr("Render") + QLatin1String(": </b>");
+    msg += renderTime < 0 ? QString(unknown) : tr("%1 ms").arg(renderTime);
+    msg += QLatin1String("&nbsp;&nbsp;<b>") + tr("Cache") + QLatin1String(": </b>");
+    msg += tr("%1% hits, %2 MB").arg( qRound(hitRate * 100) ).arg(cacheBytes / 1048576.0, 0, 'f', 1);
+    msg += QLatin1String("&nbsp;&nbsp;<b>") + tr("Renders") + QLatin1String(": </b>");
+    msg += QString::number(pendingRenders);
+    msg += QLatin1String("&nbsp;&nbsp;<b>") + tr("RSS") + QLatin1String(": </b>");
+    msg += rss < 0 ? QString(unknown) : tr("%1 MB").arg(rss / 1048576.0, 0, 'f', 1);
+    _diagnosticsLabel->setText(msg);
 }
@@ -22,17 +22,18 @@ class StatusBar : public QWidget
 
 public:
     explicit StatusBar(QWidget *parent = nullptr);
-    
-    void setLanguage(const QString& lang);
-    void setPosition(int row, int col);
-    void setCodec(const QString& codec);
+
+    void setPage(int page, int pageCount);
     void setZoom(const QString& zoom);
 
+    // the performance readout: times in ms, sizes in bytes (-1 if unknown)
+    void setDiagnosticsVisible(bool visible);
+    void setDiagnostics(qint64 renderTime, qreal hitRate, qint64 cacheBytes, int pendingRenders, qint64 rss);
+
 private:
-    QLabel* _langLabel;
-    QLabel* _posLabel;
-    QLabel* _codecLabel;
+    QLabel* _pageLabel;
     QLabel* _zoomLabel;
+    QLabel* _diagnosticsLabel;
 };
 
 #endif
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "textextractor.h"
+
+#include "batchrenderer.h"
+#include "tracing.h"
+
+#include <QtConcurrent>
+
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QQueue>
+#include <QSharedPointer>
+#include <QTextStream>
+#include <QThreadPool>
+
+#include <QPdfDocument>
+
+#include <climits>
+
+
+// pages queued for each worker thread: enough to keep them busy
+// while the output waits for a slow page, without piling up text
+static const int PENDING_PAGES_PER_JOB = 4;
+
+
+struct PageText
+{
+    // each page keeps its document open, until it is written
+    QSharedPointer<QPdfDocument> document;
+    QString path;
+    int page;
+    QFuture<QString> text;
+};
+
+
+static QString extractPage(QPdfDocument *document, int page)
+{
+    TRACE_SCOPE_ARG("extract", "extract text", "page", page);
+    return document->getAllText(page).text();
+}
+
+
+static void writePage(QFile &out, const PageText &item, bool jsonl)
+{
+    // about to wait: what is ready reaches the reader first
+    if (!item.text.isFinished()) {
+        out.flush();
+    }
+    const QString text = item.text.result();
+
+    if (jsonl) {
+        QJsonObject object;
+        object.insert( QStringLiteral("file"), item.path );
+        object.insert( QStringLiteral("page"), item.page + 1 );
+        object.insert( QStringLiteral("text"), text );
+        out.write( QJsonDocument(object).toJson(QJsonDocument::Compact) );
+        out.write("\n");
+    } else {
+        out.write( text.toUtf8() );
+        out.write("\f");
+    }
+}
+
+
+TextExtractor::TextExtractor()
+    : _format( QStringLiteral("txt") )
+    , _jobs(QThread::idealThreadCount())
+    , _firstPage(1)
+    , _lastPage(INT_MAX)
+{
+}
+
+
+bool TextExtractor::setFormat(const QString &format)
+{
+    const QString f = format.toLower();
+    if (f != QLatin1String("txt") && f != QLatin1String("jsonl")) {
+        return false;
+    }
+    _format = f;
+    return true;
+}
+
+
+bool TextExtractor::setPageRange(const QString &range)
+{
+    return BatchRenderer::parsePageRange(range, &_firstPage, &_lastPage);
+}
+
+
+int TextExtractor::run(const QStringList &files) const
+{
+    QTextStream err(stderr);
+
+    QFile out;
+    if (!out.open(stdout, QIODevice::WriteOnly)) {
+        err << tr("Cannot write to the standard output") << Qt::endl;
+        return 1;
+    }
+    const bool jsonl = _format == QLatin1String("jsonl");
+
+    QThreadPool pool;
+    pool.setMaxThreadCount( qMax(1, _jobs) );
+    const int maxPending = pool.maxThreadCount() * PENDING_PAGES_PER_JOB;
+
+    // the pages being extracted, in output order: the next documents
+    // are opened while the pages of the previous ones are extracted
+    QQueue<PageText> pending;
+    int failures = 0;
+
+    for (const QString &path : files) {
+        QSharedPointer<QPdfDocument> document(new QPdfDocument);
+        if (document->load(path) != QPdfDocument::NoError) {
+            err << tr("Cannot open %1").arg(path) << Qt::endl;
+            ++failures;
+            continue;
+        }
+
+        const int last = qMin(_lastPage, document->pageCount());
+        for (int page = _firstPage; page <= last; ++page) {
+            if (pending.count() >= maxPending) {
+                writePage(out, pending.dequeue(), jsonl);
+            }
+
+            PageText item;
+            item.document = document;
+            item.path = path;
+            item.page = page - 1;
+            item.text = QtConcurrent::run(&pool, extractPage, document.data(), page - 1);
+            pending.enqueue(item);
+        }
+    }
+
+    while (!pending.isEmpty()) {
+        writePage(out, pending.dequeue(), jsonl);
+    }
+    out.flush();
+
+    return failures ? 1 : 0;
+}
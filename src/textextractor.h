@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef TEXTEXTRACTOR_H
+#define TEXTEXTRACTOR_H
+
+
+#include <QCoreApplication>
+#include <QString>
+#include <QStringList>
+
+
+// Writes the text of the pages of documents on the standard output,
+// without any window.
+// Pages of all the documents are extracted by a thread pool, a bounded
+// number at a time, and written in order as soon as they are ready.
+class TextExtractor
+{
+    Q_DECLARE_TR_FUNCTIONS(TextExtractor)
+
+public:
+    TextExtractor();
+
+    inline void setJobs(int jobs) { _jobs = jobs; }
+
+    // txt (pages ended by a form feed) or jsonl (a JSON object per page)
+    bool setFormat(const QString &format);
+
+    // first-last, first-, or a single page, counting from 1
+    bool setPageRange(const QString &range);
+
+    // returns the process exit code
+    int run(const QStringList &files) const;
+
+private:
+    QString _format;
+    int _jobs;
+    int _firstPage;
+    int _lastPage;
+};
+
+#endif // TEXTEXTRACTOR_H
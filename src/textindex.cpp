@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "textindex.h"
+
+#include "tracing.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QVector>
+
+#include <QPdfDocument>
+#include <QPdfSelection>
+
+
+// the entry file format
+static const quint32 TEXT_INDEX_MAGIC = 0x43565458;
+static const quint32 TEXT_INDEX_VERSION = 1;
+
+// touched at every prune
+static const char PRUNE_MARKER[] = "pruned";
+
+
+const qint64 TextIndex::MAX_SIZE;
+const int TextIndex::PRUNE_INTERVAL;
+
+
+// the file path an entry was written for (empty if unreadable)
+static QString entryOwner(const QString &entryPath)
+{
+    QFile entry(entryPath);
+    if (!entry.open(QIODevice::ReadOnly)) {
+        return QString();
+    }
+
+    QDataStream in(&entry);
+    in.setVersion(QDataStream::Qt_5_15);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    QString path;
+    in >> magic >> version;
+    if (magic == TEXT_INDEX_MAGIC && version == TEXT_INDEX_VERSION) {
+        in >> path;
+    }
+    return in.status() == QDataStream::Ok ? path : QString();
+}
+
+
+TextIndex::TextIndex(const QString &directory)
+    : _directory(directory)
+{
+}
+
+
+QString TextIndex::defaultDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QLatin1String("/text");
+}
+
+
+QString TextIndex::entryFilePath(const QString &path) const
+{
+    const QByteArray hash = QCryptographicHash::hash(path.toUtf8(), QCryptographicHash::Sha1);
+    return _directory + QLatin1Char('/') + QString::fromLatin1( hash.toHex() ) + QLatin1String(".text");
+}
+
+
+TextIndex::Status TextIndex::pageTexts(const QString &path, QStringList *texts, const QAtomicInt *cancelled) const
+{
+    const QFileInfo info(path);
+    const QString filePath = info.absoluteFilePath();
+    const qint64 size = info.size();
+    const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+    const QString entryPath = entryFilePath(filePath);
+
+    // the entry of the file, if it did not change since
+    QFile entry(entryPath);
+    if (entry.open(QIODevice::ReadOnly)) {
+        TRACE_SCOPE("textindex", "read text entry");
+
+        QDataStream in(&entry);
+        in.setVersion(QDataStream::Qt_5_15);
+
+        quint32 magic = 0;
+        quint32 version = 0;
+        QString entryFile;
+        qint64 entrySize = -1;
+        qint64 entryModified = -1;
+        in >> magic >> version;
+        if (magic == TEXT_INDEX_MAGIC && version == TEXT_INDEX_VERSION) {
+            in >> entryFile >> entrySize >> entryModified;
+        }
+
+        if (in.status() == QDataStream::Ok && entryFile == filePath
+            && entrySize == size && entryModified == modified) {
+            QByteArray compressed;
+            in >> compressed;
+            QDataStream pages( qUncompress(compressed) );
+            pages.setVersion(QDataStream::Qt_5_15);
+            pages >> *texts;
+            if (in.status() == QDataStream::Ok && pages.status() == QDataStream::Ok) {
+                // the entry was used: it is the last to be pruned
+                entry.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+                return Cached;
+            }
+            texts->clear();
+        }
+        entry.close();
+    }
+
+    TRACE_SCOPE("textindex", "extract text entry");
+
+    QPdfDocument document;
+    if (document.load(filePath) != QPdfDocument::NoError) {
+        return Failed;
+    }
+
+    texts->clear();
+    for (int page = 0; page < document.pageCount(); ++page) {
+        if (cancelled && cancelled->loadAcquire()) {
+            texts->clear();
+            return Failed;
+        }
+        texts->append( document.getAllText(page).text() );
+    }
+    document.close();
+
+    // the entry is written again from scratch, never left half done
+    QByteArray pages;
+    QDataStream out(&pages, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_15);
+    out << *texts;
+
+    QDir().mkpath(_directory);
+    QSaveFile saved(entryPath);
+    if (saved.open(QIODevice::WriteOnly)) {
+        QDataStream header(&saved);
+        header.setVersion(QDataStream::Qt_5_15);
+        header << TEXT_INDEX_MAGIC << TEXT_INDEX_VERSION
+               << filePath << size << modified
+               << qCompress(pages);
+        saved.commit();
+    }
+
+    return Extracted;
+}
+
+
+void TextIndex::prune(const QAtomicInt *cancelled) const
+{
+    const QFileInfo marker(_directory + QLatin1Char('/') + QLatin1String(PRUNE_MARKER));
+    if (!QFileInfo(_directory).isDir()
+        || (marker.exists() && marker.lastModified().secsTo( QDateTime::currentDateTime() ) < PRUNE_INTERVAL)) {
+        return;
+    }
+
+    TRACE_SCOPE("textindex", "prune text index");
+
+    // the least recently used first
+    const QFileInfoList entries = QDir(_directory).entryInfoList(QStringList() << QStringLiteral("*.text"),
+                                                                 QDir::Files, QDir::Time | QDir::Reversed);
+    qint64 size = 0;
+    QVector<bool> removed(entries.count(), false);
+    for (int i = 0; i < entries.count(); ++i) {
+        if (cancelled && cancelled->loadAcquire()) {
+            return;
+        }
+
+        // the file may have been renamed, moved or deleted
+        const QFileInfo &info = entries.at(i);
+        const QString path = entryOwner( info.absoluteFilePath() );
+        if ((path.isEmpty() || !QFileInfo::exists(path)) && QFile::remove( info.absoluteFilePath() )) {
+            removed[i] = true;
+        } else {
+            size += info.size();
+        }
+    }
+
+    // some room is made, not to prune again at the next search
+    const qint64 target = MAX_SIZE / 10 * 9;
+    for (int i = 0; i < entries.count() && size > MAX_SIZE; ++i) {
+        if (!removed.at(i) && QFile::remove( entries.at(i).absoluteFilePath() )) {
+            size -= entries.at(i).size();
+        }
+        if (size <= target) {
+            break;
+        }
+    }
+
+    QFile touched( marker.absoluteFilePath() );
+    if (touched.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        touched.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+    }
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef TEXTINDEX_H
+#define TEXTINDEX_H
+
+
+#include <QAtomicInt>
+#include <QString>
+#include <QStringList>
+
+
+// The text of the pages of PDF files, kept on disk: one compressed entry
+// per file, named by its path and holding its size and modification time.
+// A file is opened and its text extracted again only once it changed.
+// Entries are written whole (or not at all): workers may read and write
+// the entries of different files at the same time.
+// Entries are pruned once a day at most: the ones of files gone (renamed,
+// moved or deleted), then the least recently used over MAX_SIZE.
+class TextIndex
+{
+public:
+    // the size of the entries on disk, at most
+    static const qint64 MAX_SIZE = qint64(1024) * 1024 * 1024;
+
+    // how often the entries are pruned, in seconds
+    static const int PRUNE_INTERVAL = 24 * 60 * 60;
+
+    enum Status {
+        Failed = 0,
+        Cached,
+        Extracted
+    };
+
+    explicit TextIndex(const QString &directory = defaultDirectory());
+
+    static QString defaultDirectory();
+
+    // the text of each page of path, from the index unless the file changed;
+    // extraction stops (and nothing is stored) once cancelled is set
+    Status pageTexts(const QString &path, QStringList *texts, const QAtomicInt *cancelled = nullptr) const;
+
+    // prunes the entries, unless it was done less than PRUNE_INTERVAL ago:
+    // it reads every entry, and stops once cancelled is set
+    void prune(const QAtomicInt *cancelled = nullptr) const;
+
+private:
+    QString entryFilePath(const QString &path) const;
+
+private:
+    QString _directory;
+};
+
+#endif // TEXTINDEX_H
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "textscan.h"
+
+#include <QtAlgorithms>
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TEXTSCAN_SSE2
+#endif
+
+// AVX2 is built for a single function, and chosen at run time
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define TEXTSCAN_AVX2
+#endif
+
+
+// true if the chars between the first and the last ones are the same
+static inline bool middleMatches(const QChar *text, const QChar *pattern, int patternLength)
+{
+    return patternLength <= 2
+        || std::memcmp(text + 1, pattern + 1, (patternLength - 2) * sizeof(QChar)) == 0;
+}
+
+
+static int indexOfScalar(const QChar *text, int length, const QChar *pattern, int patternLength, int from)
+{
+    const QChar first = pattern[0];
+    const QChar last = pattern[patternLength - 1];
+    for (int i = from; i + patternLength <= length; ++i) {
+        if (text[i] == first && text[i + patternLength - 1] == last
+            && middleMatches(text + i, pattern, patternLength)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+#ifdef TEXTSCAN_SSE2
+
+static int indexOfSse2(const QChar *text, int length, const QChar *pattern, int patternLength, int from)
+{
+    const __m128i first = _mm_set1_epi16( short(pattern[0].unicode()) );
+    const __m128i last = _mm_set1_epi16( short(pattern[patternLength - 1].unicode()) );
+
+    // both loads stay within the text
+    int i = from;
+    for (; i + patternLength + 7 <= length; i += 8) {
+        const __m128i blockFirst = _mm_loadu_si128( reinterpret_cast<const __m128i *>(text + i) );
+        const __m128i blockLast = _mm_loadu_si128( reinterpret_cast<const __m128i *>(text + i + patternLength - 1) );
+        const __m128i equal = _mm_and_si128( _mm_cmpeq_epi16(blockFirst, first), _mm_cmpeq_epi16(blockLast, last) );
+
+        // two bits for each position
+        quint32 mask = quint32( _mm_movemask_epi8(equal) );
+        while (mask) {
+            const int bit = int( qCountTrailingZeroBits(mask) );
+            const int position = i + bit / 2;
+            if (middleMatches(text + position, pattern, patternLength)) {
+                return position;
+            }
+            mask &= ~(3u << bit);
+        }
+    }
+    return indexOfScalar(text, length, pattern, patternLength, i);
+}
+
+#endif // TEXTSCAN_SSE2
+
+
+#ifdef TEXTSCAN_AVX2
+
+// the SSE2 scan, on sixteen positions
+__attribute__((target("avx2")))
+static int indexOfAvx2(const QChar *text, int length, const QChar *pattern, int patternLength, int from)
+{
+    const __m256i first = _mm256_set1_epi16( short(pattern[0].unicode()) );
+    const __m256i last = _mm256_set1_epi16( short(pattern[patternLength - 1].unicode()) );
+
+    int i = from;
+    for (; i + patternLength + 15 <= length; i += 16) {
+        const __m256i blockFirst = _mm256_loadu_si256( reinterpret_cast<const __m256i *>(text + i) );
+        const __m256i blockLast = _mm256_loadu_si256( reinterpret_cast<const __m256i *>(text + i + patternLength - 1) );
+        const __m256i equal = _mm256_and_si256( _mm256_cmpeq_epi16(blockFirst, first), _mm256_cmpeq_epi16(blockLast, last) );
+
+        quint32 mask = quint32( _mm256_movemask_epi8(equal) );
+        while (mask) {
+            const int bit = int( qCountTrailingZeroBits(mask) );
+            const int position = i + bit / 2;
+            if (middleMatches(text + position, pattern, patternLength)) {
+                return position;
+            }
+            mask &= ~(3u << bit);
+        }
+    }
+    return indexOfScalar(text, length, pattern, patternLength, i);
+}
+
+#endif // TEXTSCAN_AVX2
+
+
+bool TextScan::isSupported(Kernel kernel)
+{
+    switch (kernel) {
+    case Scalar:
+        return true;
+    case Sse2:
+#ifdef TEXTSCAN_SSE2
+        return true;
+#else
+        return false;
+#endif
+    case Avx2:
+#ifdef TEXTSCAN_AVX2
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+    return false;
+}
+
+
+TextScan::Kernel TextScan::bestKernel()
+{
+    static const Kernel best = isSupported(Avx2) ? Avx2 : (isSupported(Sse2) ? Sse2 : Scalar);
+    return best;
+}
+
+
+int TextScan::indexOf(const QString &text, const QString &pattern, int from)
+{
+    return indexOf(text, pattern, from, bestKernel());
+}
+
+
+int TextScan::indexOf(const QString &text, const QString &pattern, int from, Kernel kernel)
+{
+    from = qMax(0, from);
+    if (pattern.isEmpty() || from + pattern.size() > text.size()) {
+        return -1;
+    }
+
+    switch (isSupported(kernel) ? kernel : Scalar) {
+#ifdef TEXTSCAN_AVX2
+    case Avx2:
+        return indexOfAvx2(text.constData(), text.size(), pattern.constData(), pattern.size(), from);
+#endif
+#ifdef TEXTSCAN_SSE2
+    case Sse2:
+        return indexOfSse2(text.constData(), text.size(), pattern.constData(), pattern.size(), from);
+#endif
+    default:
+        return indexOfScalar(text.constData(), text.size(), pattern.constData(), pattern.size(), from);
+    }
+}
+
+
+QChar TextScan::fold(QChar c, bool caseFold, bool stripDiacritics)
+{
+    // most of the text
+    if (c.unicode() < 0x80) {
+        if (caseFold && c.unicode() >= 'A' && c.unicode() <= 'Z') {
+            return QChar( c.unicode() + ('a' - 'A') );
+        }
+        return c;
+    }
+
+    // only letters followed by marks: syllables (as Hangul) stay whole
+    while (stripDiacritics && c.decompositionTag() == QChar::Canonical) {
+        const QString decomposition = c.decomposition();
+        bool marks = true;
+        for (int i = 1; i < decomposition.size(); ++i) {
+            marks = marks && decomposition.at(i).isMark();
+        }
+        if (!marks) {
+            break;
+        }
+        c = decomposition.at(0);
+    }
+
+    return caseFold ? c.toCaseFolded() : c;
+}
+
+
+QString TextScan::fold(const QString &text, bool caseFold, bool stripDiacritics)
+{
+    QString folded(text.size(), Qt::Uninitialized);
+    const QChar* in = text.constData();
+    QChar* out = folded.data();
+    for (int i = 0; i < text.size(); ++i) {
+        out[i] = fold(in[i], caseFold, stripDiacritics);
+    }
+    return folded;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef TEXTSCAN_H
+#define TEXTSCAN_H
+
+
+#include <QString>
+
+
+// Substring scan over UTF-16 text, and the folding that makes it case
+// and diacritics insensitive.
+// The scan compares the first and the last char of the pattern with
+// eight (SSE2) or sixteen (AVX2) positions at a time, when the CPU can,
+// and the whole pattern only where both are there.
+// Folding maps each char to a single char: offsets in the folded text
+// are the offsets in the text.
+class TextScan
+{
+public:
+    enum Kernel {
+        Scalar = 0,
+        Sse2,
+        Avx2
+    };
+
+    static bool isSupported(Kernel kernel);
+    static Kernel bestKernel();
+
+    // the first position of pattern in text at or after from, -1 if none
+    static int indexOf(const QString &text, const QString &pattern, int from = 0);
+    static int indexOf(const QString &text, const QString &pattern, int from, Kernel kernel);
+
+    // lower case, and the base letter of the accented ones: chars written
+    // decomposed (a letter followed by its accents) keep their accents
+    static QChar fold(QChar c, bool caseFold, bool stripDiacritics);
+    static QString fold(const QString &text, bool caseFold, bool stripDiacritics);
+};
+
+#endif // TEXTSCAN_H
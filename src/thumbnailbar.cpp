@@ -0,0 +1,105 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "thumbnailbar.h"
+
+#include "thumbnailmodel.h"
+
+#include <QListView>
+#include <QScrollBar>
+#include <QTimer>
+
+
+ThumbnailBar::ThumbnailBar(RenderCache *cache, QWidget *parent)
+    : QDockWidget(tr("Thumbnails"), parent)
+    , _model(new ThumbnailModel(cache, this))
+    , _list(new QListView(this))
+    , _requestTimer(new QTimer(this))
+{
+    setObjectName( QStringLiteral("Thumbnails") );
+
+    _model->setDevicePixelRatio( devicePixelRatioF() );
+
+    // a single column of fixed size cells: only the visible ones are asked for data
+    const QSize iconSize(ThumbnailModel::THUMBNAIL_WIDTH, ThumbnailModel::THUMBNAIL_HEIGHT);
+    _list->setModel(_model);
+    _list->setViewMode(QListView::IconMode);
+    _list->setFlow(QListView::TopToBottom);
+    _list->setWrapping(false);
+    _list->setMovement(QListView::Static);
+    _list->setResizeMode(QListView::Adjust);
+    _list->setUniformItemSizes(true);
+    _list->setIconSize(iconSize);
+    _list->setGridSize( iconSize + QSize(16, fontMetrics().height() + 16) );
+    _list->setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    _list->setFixedWidth( _list->gridSize().width() + _list->verticalScrollBar()->sizeHint().width() + 2 * _list->frameWidth() );
+    setWidget(_list);
+
+    _requestTimer->setSingleShot(true);
+    _requestTimer->setInterval(0);
+    connect(_requestTimer, &QTimer::timeout, this, &ThumbnailBar::requestVisibleRows);
+
+    connect(_list->verticalScrollBar(), &QScrollBar::valueChanged, _requestTimer, QOverload<>::of(&QTimer::start));
+    connect(_model, &QAbstractItemModel::modelReset, _requestTimer, QOverload<>::of(&QTimer::start));
+    connect(this, &QDockWidget::visibilityChanged, _requestTimer, QOverload<>::of(&QTimer::start));
+
+    connect(_list, &QListView::clicked, this, [=] (const QModelIndex &index) {
+            Q_EMIT pageActivated(index.row());
+        }
+    );
+}
+
+
+void ThumbnailBar::setDocument(QPdfDocument *document)
+{
+    _model->setDocument(document);
+}
+
+
+void ThumbnailBar::setContentHash(const QByteArray &hash)
+{
+    _model->setContentHash(hash);
+}
+
+
+void ThumbnailBar::setCurrentPage(int page)
+{
+    const QModelIndex index = _model->index(page);
+    if (!index.isValid() || _list->currentIndex() == index) {
+        return;
+    }
+    _list->setCurrentIndex(index);
+    _list->scrollTo(index);
+}
+
+
+void ThumbnailBar::resizeEvent(QResizeEvent *event)
+{
+    QDockWidget::resizeEvent(event);
+    _requestTimer->start();
+}
+
+
+void ThumbnailBar::requestVisibleRows()
+{
+    if (!isVisible() || _model->rowCount() == 0) {
+        return;
+    }
+
+    const QRect area = _list->viewport()->rect();
+    const int rowHeight = _list->gridSize().height();
+    const int visibleRows = area.height() / rowHeight + 2;
+
+    // a cell in the middle of the first row, not to hit the grid spacing
+    const QModelIndex first = _list->indexAt( QPoint(area.center().x(), area.top() + rowHeight / 2) );
+    const int firstRow = first.isValid() ? first.row() : 0;
+
+    // a screenful before and after is ready before it is scrolled in
+    _model->request(firstRow - visibleRows, firstRow + 2 * visibleRows);
+}
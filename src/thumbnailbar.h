@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef THUMBNAILBAR_H
+#define THUMBNAILBAR_H
+
+
+#include <QDockWidget>
+
+class QListView;
+class QPdfDocument;
+class QTimer;
+
+class RenderCache;
+class ThumbnailModel;
+
+
+// The page thumbnails, docked beside the view.
+// Only the rows in sight (and a screenful around them) are rendered.
+class ThumbnailBar : public QDockWidget
+{
+    Q_OBJECT
+
+public:
+    ThumbnailBar(RenderCache *cache, QWidget *parent = nullptr);
+
+    void setDocument(QPdfDocument *document);
+    void setContentHash(const QByteArray &hash);
+
+public Q_SLOTS:
+    void setCurrentPage(int page);
+
+Q_SIGNALS:
+    void pageActivated(int page);
+
+protected:
+    void resizeEvent(QResizeEvent *event) override;
+
+private Q_SLOTS:
+    void requestVisibleRows();
+
+private:
+    ThumbnailModel* _model;
+    QListView* _list;
+
+    // scrolling asks for the rows once per event loop round
+    QTimer* _requestTimer;
+};
+
+#endif // THUMBNAILBAR_H
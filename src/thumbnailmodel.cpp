@@ -0,0 +1,389 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "thumbnailmodel.h"
+
+#include "rendercache.h"
+#include "tracing.h"
+
+#include <QtConcurrent>
+
+#include <QBuffer>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QPdfDocument>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+
+// the disk cache file format
+static const quint32 THUMBNAILS_MAGIC = 0x43565448;
+static const quint32 THUMBNAILS_VERSION = 1;
+
+// the size of the disk cache files, at most
+static const qint64 THUMBNAILS_MAX_SIZE = 256 * 1024 * 1024;
+
+
+static void trimThumbnails(const QString &directory)
+{
+    // the least recently used first
+    const QFileInfoList files = QDir(directory).entryInfoList(QStringList() << QStringLiteral("*.thumbnails"),
+                                                              QDir::Files, QDir::Time | QDir::Reversed);
+    qint64 size = 0;
+    for (const QFileInfo &info : files) {
+        size += info.size();
+    }
+    if (size <= THUMBNAILS_MAX_SIZE) {
+        return;
+    }
+
+    // some room is made, not to trim again at the next save
+    const qint64 target = THUMBNAILS_MAX_SIZE / 10 * 9;
+    for (const QFileInfo &info : files) {
+        if (size <= target) {
+            break;
+        }
+        if (QFile::remove(info.absoluteFilePath())) {
+            size -= info.size();
+        }
+    }
+}
+
+
+static ThumbnailHash loadThumbnails(const QString &path)
+{
+    TRACE_SCOPE("thumbnails", "load thumbnails");
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return ThumbnailHash();
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_15);
+
+    quint32 magic = 0;
+    quint32 version = 0;
+    ThumbnailHash thumbnails;
+    in >> magic >> version;
+    if (magic != THUMBNAILS_MAGIC || version != THUMBNAILS_VERSION) {
+        return ThumbnailHash();
+    }
+    in >> thumbnails;
+    if (in.status() != QDataStream::Ok) {
+        return ThumbnailHash();
+    }
+
+    // the file was used: it is the last to be trimmed
+    file.setFileTime(QDateTime::currentDateTimeUtc(), QFileDevice::FileModificationTime);
+    return thumbnails;
+}
+
+
+static void saveThumbnails(const QString &path, const ThumbnailHash &thumbnails)
+{
+    TRACE_SCOPE("thumbnails", "save thumbnails");
+
+    QDir().mkpath( QFileInfo(path).absolutePath() );
+
+    // the old file is replaced only when the new one is complete
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_15);
+    out << THUMBNAILS_MAGIC << THUMBNAILS_VERSION << thumbnails;
+    if (file.commit()) {
+        trimThumbnails( QFileInfo(path).absolutePath() );
+    }
+}
+
+
+ThumbnailModel::ThumbnailModel(RenderCache *cache, QObject *parent)
+    : QAbstractListModel(parent)
+    , _cache(cache)
+    , _document(nullptr)
+    , _devicePixelRatio(1.0)
+    , _images(16 * 1024)
+    , _dirty(false)
+    , _saveTimer(new QTimer(this))
+    , _loadWatcher(nullptr)
+{
+    // new thumbnails are saved in batches
+    _saveTimer->setSingleShot(true);
+    _saveTimer->setInterval(2000);
+    connect(_saveTimer, &QTimer::timeout, this, &ThumbnailModel::save);
+
+    connect(_cache, &RenderCache::pageRendered, this, &ThumbnailModel::onPageRendered);
+
+    if (_cache->memoryGovernor()) {
+        _cache->memoryGovernor()->addConsumer(this, MemoryGovernor::ThumbnailPriority);
+    }
+}
+
+
+ThumbnailModel::~ThumbnailModel()
+{
+    setDocument(nullptr);
+}
+
+
+qint64 ThumbnailModel::memoryUsed() const
+{
+    qint64 used = qint64(_images.totalCost()) * 1024;
+    for (auto it = _encoded.constBegin(); it != _encoded.constEnd(); ++it) {
+        used += it.value().size();
+    }
+    return used;
+}
+
+
+qint64 ThumbnailModel::trimMemory(qint64 bytes)
+{
+    Q_UNUSED(bytes)
+
+    const qint64 freed = qint64(_images.totalCost()) * 1024;
+    _images.clear();
+    return freed;
+}
+
+
+void ThumbnailModel::setDocument(QPdfDocument *document)
+{
+    // what is still to be saved goes in the file of the previous document
+    save();
+
+    for (int page : qAsConst(_requested)) {
+        _cache->cancel(thumbnailKey(page), this);
+    }
+
+    if (_loadWatcher) {
+        QFutureWatcher<ThumbnailHash>* watcher = _loadWatcher;
+        watcher->disconnect(this);
+        connect(watcher, &QFutureWatcherBase::finished, watcher, &QObject::deleteLater);
+        _loadWatcher = nullptr;
+    }
+
+    beginResetModel();
+    _document = document;
+    _contentHash.clear();
+    _encoded.clear();
+    _images.clear();
+    _requested.clear();
+    _dirty = false;
+    endResetModel();
+}
+
+
+void ThumbnailModel::setContentHash(const QByteArray &hash)
+{
+    if (!_document || !_contentHash.isEmpty()) {
+        return;
+    }
+    _contentHash = hash;
+
+    _loadWatcher = new QFutureWatcher<ThumbnailHash>;
+    connect(_loadWatcher, &QFutureWatcherBase::finished, this, &ThumbnailModel::onThumbnailsLoaded);
+    _loadWatcher->setFuture( QtConcurrent::run(loadThumbnails, cacheFilePath()) );
+}
+
+
+void ThumbnailModel::request(int first, int last)
+{
+    if (!_document) {
+        return;
+    }
+
+    first = qMax(first, 0);
+    last = qMin(last, rowCount() - 1);
+
+    // rows scrolled away are not worth a render anymore
+    const QList<int> requested = _requested.values();
+    for (int page : requested) {
+        if (page < first || page > last) {
+            _cache->cancel(thumbnailKey(page), this);
+            _requested.remove(page);
+        }
+    }
+
+    for (int page = first; page <= last; ++page) {
+        if (_encoded.contains(page) || _requested.contains(page)) {
+            continue;
+        }
+        _requested.insert(page);
+
+        // it may be there already, from a previous request
+        const RenderKey key = thumbnailKey(page);
+        if (_cache->contains(key)) {
+            onPageRendered(_document, page);
+        } else {
+            _cache->request(key, thumbnailSize(page), RenderCache::ThumbnailPriority, this);
+        }
+    }
+}
+
+
+int ThumbnailModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid() || !_document) {
+        return 0;
+    }
+    return _document->pageCount();
+}
+
+
+QVariant ThumbnailModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid()) {
+        return QVariant();
+    }
+    const int page = index.row();
+
+    if (role == Qt::DisplayRole) {
+        return QString::number(page + 1);
+    }
+
+    if (role != Qt::DecorationRole) {
+        return QVariant();
+    }
+
+    if (QImage* image = _images.object(page)) {
+        return *image;
+    }
+
+    const QByteArray encoded = _encoded.value(page);
+    if (encoded.isEmpty()) {
+        return QVariant();
+    }
+
+    // the thumbnail fits the box in one direction: that gives its pixel ratio
+    QImage image = QImage::fromData(encoded);
+    if (image.isNull()) {
+        return QVariant();
+    }
+    image.setDevicePixelRatio( qMax(qreal(image.width()) / THUMBNAIL_WIDTH, qreal(image.height()) / THUMBNAIL_HEIGHT) );
+    _images.insert(page, new QImage(image), qMax(1, int(image.sizeInBytes() / 1024)));
+    return image;
+}
+
+
+void ThumbnailModel::onPageRendered(const QPdfDocument *document, int page)
+{
+    if (document != _document || !_requested.contains(page)) {
+        return;
+    }
+
+    const QImage image = _cache->image( thumbnailKey(page) );
+    if (image.isNull()) {
+        // a page, not its thumbnail
+        return;
+    }
+    _requested.remove(page);
+
+    QByteArray encoded;
+    QBuffer buffer(&encoded);
+    buffer.open(QIODevice::WriteOnly);
+    if (!image.save(&buffer, "JPG", 85)) {
+        image.save(&buffer, "PNG");
+    }
+
+    _encoded.insert(page, encoded);
+    _images.insert(page, new QImage(image), qMax(1, int(image.sizeInBytes() / 1024)));
+
+    _dirty = true;
+    _saveTimer->start();
+
+    const QModelIndex i = index(page);
+    Q_EMIT dataChanged(i, i, QVector<int>() << Qt::DecorationRole);
+}
+
+
+void ThumbnailModel::onThumbnailsLoaded()
+{
+    const ThumbnailHash loaded = _loadWatcher->result();
+    _loadWatcher->deleteLater();
+    _loadWatcher = nullptr;
+
+    // the ones rendered in the meantime are kept
+    for (ThumbnailHash::const_iterator it = loaded.constBegin(); it != loaded.constEnd(); ++it) {
+        if (_encoded.contains(it.key())) {
+            continue;
+        }
+        _encoded.insert(it.key(), it.value());
+        if (_requested.remove(it.key())) {
+            _cache->cancel(thumbnailKey(it.key()), this);
+        }
+    }
+
+    // saving was held back not to overwrite the file being loaded
+    if (_dirty) {
+        _saveTimer->start();
+    }
+
+    if (rowCount() > 0) {
+        Q_EMIT dataChanged(index(0), index(rowCount() - 1), QVector<int>() << Qt::DecorationRole);
+    }
+}
+
+
+void ThumbnailModel::save()
+{
+    _saveTimer->stop();
+
+    if (!_dirty || _contentHash.isEmpty() || _loadWatcher) {
+        return;
+    }
+    _dirty = false;
+
+    // the hash is implicitly shared: the worker writes a snapshot of it
+    QtConcurrent::run(saveThumbnails, cacheFilePath(), _encoded);
+}
+
+
+RenderKey ThumbnailModel::thumbnailKey(const QPdfDocument *document, int page, qreal devicePixelRatio)
+{
+    return RenderKey(document, page, 1.0, devicePixelRatio, RenderKey::THUMBNAIL_TILE);
+}
+
+
+QSize ThumbnailModel::thumbnailSize(const QSizeF &pageSize, qreal devicePixelRatio)
+{
+    if (pageSize.isEmpty()) {
+        return QSize();
+    }
+
+    const qreal scale = qMin(THUMBNAIL_WIDTH / pageSize.width(), THUMBNAIL_HEIGHT / pageSize.height());
+    return (pageSize * scale * devicePixelRatio).toSize();
+}
+
+
+RenderKey ThumbnailModel::thumbnailKey(int page) const
+{
+    return thumbnailKey(_document, page, _devicePixelRatio);
+}
+
+
+QSize ThumbnailModel::thumbnailSize(int page) const
+{
+    return thumbnailSize(_document->pageSize(page), _devicePixelRatio);
+}
+
+
+QString ThumbnailModel::cacheFilePath() const
+{
+    // thumbnails are rendered for a device pixel ratio: "<hash>@2x.thumbnails"
+    const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    return cacheDir + QLatin1String("/thumbnails/") + QString::fromLatin1( _contentHash.toHex() )
+        + QStringLiteral("@%1x").arg(_devicePixelRatio) + QLatin1String(".thumbnails");
+}
@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef THUMBNAILMODEL_H
+#define THUMBNAILMODEL_H
+
+
+#include <QAbstractListModel>
+#include <QByteArray>
+#include <QCache>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QImage>
+#include <QSet>
+#include <QTimer>
+
+#include "memorygovernor.h"
+
+class QPdfDocument;
+
+class RenderCache;
+struct RenderKey;
+
+// page number -> JPEG encoded thumbnail
+typedef QHash<int, QByteArray> ThumbnailHash;
+
+
+// The page thumbnails of a document, one per row.
+// Thumbnails are rendered at low priority by the render cache, only for
+// the rows asked with request(), and saved on disk by the content hash
+// of the file: reopening it they are all there at once.
+// Under memory pressure the decoded thumbnails go first: they are
+// decoded again from the encoded ones.
+class ThumbnailModel : public QAbstractListModel, public MemoryConsumer
+{
+    Q_OBJECT
+
+public:
+    // the box thumbnails fit in, in device independent pixels
+    static const int THUMBNAIL_WIDTH = 96;
+    static const int THUMBNAIL_HEIGHT = 128;
+
+    // how the thumbnail of page is rendered and cached
+    static RenderKey thumbnailKey(const QPdfDocument *document, int page, qreal devicePixelRatio);
+    static QSize thumbnailSize(const QSizeF &pageSize, qreal devicePixelRatio);
+
+    explicit ThumbnailModel(RenderCache *cache, QObject *parent = nullptr);
+    ~ThumbnailModel();
+
+    void setDocument(QPdfDocument *document);
+
+    // enables the disk cache, once the hash of the file is known
+    void setContentHash(const QByteArray &hash);
+
+    inline void setDevicePixelRatio(qreal ratio) { _devicePixelRatio = ratio; }
+
+    // renders the missing thumbnails of the pages from first to last,
+    // and drops the queued renders of the other ones
+    void request(int first, int last);
+
+    qint64 memoryUsed() const override;
+    qint64 trimMemory(qint64 bytes) override;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+private Q_SLOTS:
+    void onPageRendered(const QPdfDocument *document, int page);
+    void onThumbnailsLoaded();
+    void save();
+
+private:
+    RenderKey thumbnailKey(int page) const;
+    QSize thumbnailSize(int page) const;
+    QString cacheFilePath() const;
+
+private:
+    RenderCache* _cache;
+    QPdfDocument* _document;
+    QByteArray _contentHash;
+    qreal _devicePixelRatio;
+
+    // every thumbnail known, encoded, and the decoded ones last shown (in KiB)
+    ThumbnailHash _encoded;
+    mutable QCache<int, QImage> _images;
+
+    QSet<int> _requested;
+
+    bool _dirty;
+    QTimer* _saveTimer;
+    QFutureWatcher<ThumbnailHash>* _loadWatcher;
+};
+
+#endif // THUMBNAILMODEL_H
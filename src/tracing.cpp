@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#include "tracing.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+
+
+QAtomicInt Trace::enabledFlag;
+
+
+namespace
+{
+    struct Event
+    {
+        const char* category;
+        const char* name;
+        const char* argName;
+        qint64 arg;
+        qint64 start;
+        qint64 duration;
+    };
+
+    // each thread records in its own buffer: the lock is (almost) never contended
+    struct ThreadBuffer
+    {
+        int tid;
+        QString name;
+        QMutex mutex;
+        QVector<Event> events;
+    };
+
+    QElapsedTimer traceClock;
+    QString traceFileName;
+
+    QMutex buffersMutex;
+    QList<ThreadBuffer*> buffers;
+
+    thread_local ThreadBuffer* threadBuffer = nullptr;
+}
+
+
+static ThreadBuffer* currentBuffer()
+{
+    if (threadBuffer) {
+        return threadBuffer;
+    }
+
+    threadBuffer = new ThreadBuffer;
+
+    QThread* thread = QThread::currentThread();
+    if (QCoreApplication::instance() && thread == QCoreApplication::instance()->thread()) {
+        threadBuffer->name = QStringLiteral("main");
+    } else {
+        threadBuffer->name = thread->objectName();
+    }
+
+    QMutexLocker locker(&buffersMutex);
+    threadBuffer->tid = buffers.count() + 1;
+    if (threadBuffer->name.isEmpty()) {
+        threadBuffer->name = QStringLiteral("thread %1").arg(threadBuffer->tid);
+    }
+    buffers.append(threadBuffer);
+    return threadBuffer;
+}
+
+
+static QString escaped(QString text)
+{
+    return text.replace(QLatin1Char('\\'), QLatin1String("\\\\")).replace(QLatin1Char('"'), QLatin1String("\\\""));
+}
+
+
+void Trace::start(const QString &fileName)
+{
+    if (fileName.isEmpty() || isEnabled()) {
+        return;
+    }
+    traceFileName = fileName;
+    traceClock.start();
+    enabledFlag.storeRelease(1);
+}
+
+
+qint64 Trace::now()
+{
+    return traceClock.nsecsElapsed();
+}
+
+
+void Trace::record(const char *category, const char *name, const char *argName, qint64 arg, qint64 start)
+{
+    const Event event = { category, name, argName, arg, start, now() - start };
+
+    ThreadBuffer* buffer = currentBuffer();
+    QMutexLocker locker(&buffer->mutex);
+    buffer->events.append(event);
+}
+
+
+bool Trace::stop()
+{
+    if (!isEnabled()) {
+        return true;
+    }
+    enabledFlag.storeRelease(0);
+
+    QFile file(traceFileName);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "Cannot write the trace file" << traceFileName << file.errorString();
+        return false;
+    }
+
+    const qint64 pid = QCoreApplication::applicationPid();
+
+    // timestamps are in microseconds
+    QTextStream out(&file);
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+
+    QMutexLocker buffersLocker(&buffersMutex);
+    for (ThreadBuffer* buffer : qAsConst(buffers)) {
+        QMutexLocker locker(&buffer->mutex);
+
+        out << (first ? "" : ",")
+            << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << buffer->tid
+            << ",\"args\":{\"name\":\"" << escaped(buffer->name) << "\"}}";
+        first = false;
+
+        for (const Event &event : qAsConst(buffer->events)) {
+            out << ",\n{\"name\":\"" << event.name << "\",\"cat\":\"" << event.category
+                << "\",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << buffer->tid
+                << ",\"ts\":" << QString::number(event.start / 1000.0, 'f', 3)
+                << ",\"dur\":" << QString::number(event.duration / 1000.0, 'f', 3);
+            if (event.argName) {
+                out << ",\"args\":{\"" << event.argName << "\":" << event.arg << "}";
+            }
+            out << "}";
+        }
+        buffer->events.clear();
+    }
+
+    out << "\n]}\n";
+    out.flush();
+    return file.error() == QFileDevice::NoError;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) Andrea Diamantini 2021 <adjam@protonmail.com>
+ *
+ * CuteViewer project
+ *
+ * @license GPL-3.0 <https://www.gnu.org/licenses/gpl-3.0.txt>
+ */
+
+
+#ifndef TRACING_H
+#define TRACING_H
+
+
+#include <QAtomicInt>
+#include <QString>
+
+
+// Timing spans of the hot paths, saved in the Chrome/Perfetto trace format.
+// Tracing is started by the CUTEVIEWER_TRACE=file.json environment variable
+// or by the --trace file.json option, and the file is written at exit.
+// When tracing is off a span costs a relaxed atomic load.
+//
+// Use it in a scope, with string literals:
+//     TRACE_SCOPE("render", "render page");
+//     TRACE_SCOPE_ARG("render", "render page", "page", page);
+namespace Trace
+{
+    extern QAtomicInt enabledFlag;
+
+    inline bool isEnabled() { return enabledFlag.loadRelaxed(); }
+
+    void start(const QString &fileName);
+
+    // writes the trace file, returns false on failure
+    bool stop();
+
+    qint64 now();
+    void record(const char *category, const char *name, const char *argName, qint64 arg, qint64 start);
+
+    class Span
+    {
+    public:
+        inline Span(const char *category, const char *name, const char *argName = nullptr, qint64 arg = 0)
+            : _category(category)
+            , _name(name)
+            , _argName(argName)
+            , _arg(arg)
+            , _start(isEnabled() ? now() : -1)
+        {}
+
+        inline ~Span()
+        {
+            if (_start >= 0) {
+                record(_category, _name, _argName, _arg, _start);
+            }
+        }
+
+    private:
+        Q_DISABLE_COPY(Span)
+
+        const char* _category;
+        const char* _name;
+        const char* _argName;
+        qint64 _arg;
+        qint64 _start;
+    };
+}
+
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+
+#define TRACE_SCOPE(category, name) \
+    Trace::Span TRACE_CONCAT(traceSpan, __LINE__)(category, name)
+
+#define TRACE_SCOPE_ARG(category, name, argName, arg) \
+    Trace::Span TRACE_CONCAT(traceSpan, __LINE__)(category, name, argName, arg)
+
+#endif // TRACING_H